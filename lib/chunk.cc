@@ -1,6 +1,111 @@
 #include "./chunk.h"
 #include "./helper.h"
 
+size_t Chunk::instructionSize(size_t offset) const {
+  switch (code[offset]) {
+    case OpCode::OP_CONSTANT:
+    case OpCode::OP_GET_LOCAL:
+    case OpCode::OP_SET_LOCAL:
+    case OpCode::OP_GET_UPVALUE:
+    case OpCode::OP_SET_UPVALUE:
+    case OpCode::OP_GET_CAPTURED:
+    case OpCode::OP_INTRINSIC:
+    case OpCode::OP_CLASS:
+    case OpCode::OP_SET_PROPERTY:
+    case OpCode::OP_METHOD:
+    case OpCode::OP_GET_SUPER:
+    case OpCode::OP_SET_LOCAL_POP: return 2;
+    case OpCode::OP_COMPOUND_LOCAL:
+    case OpCode::OP_COMPOUND_UPVALUE: return 3;
+    case OpCode::OP_CALL:
+    case OpCode::OP_TAIL_CALL:
+    case OpCode::OP_CONSTANT_LONG: return 4;
+    case OpCode::OP_JUMP_LONG:
+    case OpCode::OP_JUMP_IF_FALSE_LONG:
+    case OpCode::OP_LOOP_LONG: return 5;
+    case OpCode::OP_WIDE: {
+      if (code[offset + 1] == OpCode::OP_CLOSURE) return 4 + captureSize(offset + 4, code[offset + 2] << 8 | code[offset + 3]);
+      return instructionSize(offset + 1) + 2;  // The prefix and a byte more of the first operand.
+    }
+    case OpCode::OP_DEFINE_GLOBAL:
+    case OpCode::OP_GET_GLOBAL:
+    case OpCode::OP_SET_GLOBAL:
+    case OpCode::OP_GET_GLOBAL_DEFINED:
+    case OpCode::OP_JUMP_IF_FALSE:
+    case OpCode::OP_JUMP:
+    case OpCode::OP_LOOP:
+    case OpCode::OP_MOVE:
+    case OpCode::OP_LOAD_CONSTANT:
+    case OpCode::OP_ADD_LOCAL_LOCAL:
+    case OpCode::OP_ADD_LOCAL_CONSTANT:
+    case OpCode::OP_SUBTRACT_LOCAL_CONSTANT:
+    case OpCode::OP_LESS_LOCAL_CONSTANT:
+    case OpCode::OP_SWITCH_TABLE:
+    case OpCode::OP_SWITCH_HASH:
+    case OpCode::OP_POP_JUMP_IF_FALSE: return 3;
+    case OpCode::OP_COMPOUND_GLOBAL: return 4;
+    case OpCode::OP_ADD_RR:
+    case OpCode::OP_SUBTRACT_RR:
+    case OpCode::OP_MULTIPLY_RR:
+    case OpCode::OP_DIVIDE_RR:
+    case OpCode::OP_ADD_RK:
+    case OpCode::OP_SUBTRACT_RK:
+    case OpCode::OP_MULTIPLY_RK:
+    case OpCode::OP_DIVIDE_RK:
+    case OpCode::OP_GET_PROPERTY: return 4;
+    case OpCode::OP_JUMP_IF_NOT_LESS_RR:
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RR:
+    case OpCode::OP_JUMP_IF_NOT_LESS_RK:
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RK:
+    case OpCode::OP_INVOKE:
+    case OpCode::OP_SUPER_INVOKE:
+    case OpCode::OP_TAIL_INVOKE:
+    case OpCode::OP_TAIL_SUPER_INVOKE:
+    case OpCode::OP_CALL_GLOBAL:
+    case OpCode::OP_COMPOUND_PROPERTY: return 5;
+    case OpCode::OP_FOR_LOOP_LESS_RR:
+    case OpCode::OP_FOR_LOOP_GREATER_RR:
+    case OpCode::OP_FOR_LOOP_LESS_RK:
+    case OpCode::OP_FOR_LOOP_GREATER_RK: return 6;
+    case OpCode::OP_CLOSURE: return 2 + captureSize(offset + 2, code[offset + 1]);
+    default: return 1;
+  }
+}
+
+/**
+ * The size of the (kind, index) pairs following "OP_CLOSURE" from "offset", one for each upvalue of the function constant, -
+ * with a 16-bit index for the wide kinds.
+*/
+size_t Chunk::captureSize(size_t offset, size_t constant) const {
+  const auto function = retrieveObjFunc(constants[constant].asObj());
+  size_t size = 0;
+  for (uint32_t i = 0; i < function->upvalueCount && offset + size < code.size(); i++) {
+    size += (code[offset + size] & CAPTURE_WIDE) ? 3 : 2;
+  }
+  return size;
+}
+
+int Chunk::jumpDirection(OpCodeType instruction) {
+  switch (instruction) {
+    case OpCode::OP_JUMP:
+    case OpCode::OP_JUMP_IF_FALSE:
+    case OpCode::OP_JUMP_LONG:
+    case OpCode::OP_JUMP_IF_FALSE_LONG:
+    case OpCode::OP_JUMP_IF_NOT_LESS_RR:
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RR:
+    case OpCode::OP_JUMP_IF_NOT_LESS_RK:
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RK:
+    case OpCode::OP_POP_JUMP_IF_FALSE: return 1;
+    case OpCode::OP_LOOP:
+    case OpCode::OP_LOOP_LONG:
+    case OpCode::OP_FOR_LOOP_LESS_RR:
+    case OpCode::OP_FOR_LOOP_GREATER_RR:
+    case OpCode::OP_FOR_LOOP_LESS_RK:
+    case OpCode::OP_FOR_LOOP_GREATER_RK: return -1;
+    default: return 0;
+  }
+}
+
 void ChunkDebugger::simpleInstruction(
   const char* name, 
   typeVMCodeArray::const_iterator& offset) {
@@ -23,10 +128,22 @@ void ChunkDebugger::invokeInstruction(
   typeVMCodeArray::const_iterator& offset) {
     const auto constantIdx = *(offset + 1);
     const auto argCount = *(offset + 2);
+    const auto cacheIdx = *(offset + 3) << 8 | *(offset + 4);
     printf("%-16s args(%d) index(%4d) '", name, argCount, constantIdx);
     printValue(chunk.constants[constantIdx]);
-    printf("\n");
-    offset += 3;
+    printf("' cache(%d)\n", cacheIdx);
+    offset += 5;
+  }
+void ChunkDebugger::propertyInstruction(
+  const char* name,
+  const Chunk& chunk, 
+  typeVMCodeArray::const_iterator& offset) {
+    const auto constantIdx = *(offset + 1);
+    const auto cacheIdx = *(offset + 2) << 8 | *(offset + 3);
+    printf("%-16s index(%4d); const('", name, constantIdx);
+    printValue(chunk.constants[constantIdx]);
+    printf("') cache(%d)\n", cacheIdx);
+    offset += 4;
   }
 void ChunkDebugger::byteInstruction(
   const char* name, 
@@ -36,17 +153,207 @@ void ChunkDebugger::byteInstruction(
     printf("%-16s %s(%4d);\n", name, unit, slot);
     offset += 2;
   }
+void ChunkDebugger::globalInstruction(
+  const char* name, 
+  typeVMCodeArray::const_iterator& offset) {
+    auto slot = static_cast<uint16_t>(*(offset + 1) << 8 | *(offset + 2));
+    printf("%-16s global(%4d);\n", name, slot);
+    offset += 3;
+  }
+void ChunkDebugger::callInstruction(
+  const char* name, 
+  typeVMCodeArray::const_iterator& offset) {
+    if (*offset == OpCode::OP_CALL_GLOBAL) {
+      printf("%-16s global(%4d)", name, *(offset + 1) << 8 | *(offset + 2));
+      offset += 1;
+    } else {
+      printf("%-16s args(%d)", name, *(offset + 1));
+    }
+    printf(" cache(%d)\n", *(offset + 2) << 8 | *(offset + 3));
+    offset += 4;
+  }
+void ChunkDebugger::switchInstruction(
+  const char* name,
+  const Chunk& chunk,
+  typeVMCodeArray::const_iterator& offset) {
+    const auto tableIdx = *(offset + 1) << 8 | *(offset + 2);
+    const auto& table = chunk.switchTables[tableIdx];
+    printf("%-16s table(%d);", name, tableIdx);
+    for (const auto& label : table.labels) {
+      printf(" ");
+      printValue(label);
+      printf(" -> %zu,", *offset == OpCode::OP_SWITCH_TABLE ? table.denseTarget(label) : table.hashedTarget(label));
+    }
+    printf(" default -> %zu\n", table.defaultTarget);
+    offset += 3;
+  }
 void ChunkDebugger::jumpInstruction(
   const char* name,
   int sign,
   const Chunk& chunk, 
   typeVMCodeArray::const_iterator& offset) {
-    auto jump = static_cast<uint16_t>(*(offset + 1) << 8);
-    jump |= *(offset + 2);
     const auto rel = offset - chunk.code.cbegin();
-    printf("%-16s from(%ld) -> to(%ld)\n", name, rel, rel + 3 + sign * jump);
-    offset += 3;
+    const auto size = static_cast<long>(chunk.instructionSize(rel));
+    printf("%-16s from(%ld) -> to(%ld)\n", name, rel, rel + size + sign * static_cast<long>(chunk.jumpOffset(rel)));
+    offset += size;
+  }
+/**
+ * Print a register instruction, each character of "operands" describes one operand:
+ * "r" - local slot, "k" - constant index, "j" / "b" - 16-bit forward / backward jump offset.
+*/
+void ChunkDebugger::registerInstruction(
+  const char* name,
+  const char* operands,
+  const Chunk& chunk, 
+  typeVMCodeArray::const_iterator& offset) {
+    const auto rel = offset - chunk.code.cbegin();
+    printf("%-16s", name);
+    offset += 1;
+    for (auto kind = operands; *kind != '\0'; kind++) {
+      switch (*kind) {
+        case 'r': printf(" r(%d)", *offset++); break;
+        case 'k': {
+          printf(" const('");
+          printValue(chunk.constants[*offset++]);
+          printf("')");
+          break;
+        }
+        case 'j':
+        case 'b': {
+          auto jump = static_cast<uint16_t>(*offset << 8);
+          jump |= *(offset + 1);
+          offset += 2;
+          printf(" -> to(%ld)", (offset - chunk.code.cbegin()) + (*kind == 'j' ? jump : -jump));
+          break;
+        }
+      }
+    }
+    printf("; from(%ld)\n", rel);
   }
+void ChunkDebugger::compoundInstruction(
+  const char* name,
+  const Chunk& chunk, 
+  typeVMCodeArray::const_iterator& offset) {
+    const auto instruction = *offset;
+    printf("%-16s ", name);
+    offset += 1;
+    switch (instruction) {
+      case OpCode::OP_COMPOUND_GLOBAL: printf("global(%4d)", *offset << 8 | *(offset + 1)); offset += 2; break;
+      case OpCode::OP_COMPOUND_PROPERTY: {
+        printf("index(%4d); const('", *offset);
+        printValue(chunk.constants[*offset++]);
+        printf("')");
+        break;
+      }
+      default: printf("index(%4d)", *offset++);
+    }
+    const auto op = *offset++;
+    const auto isAdd = (op & ~COMPOUND_POSTFIX) == OpCode::OP_ADD;
+    printf(" '%s'", (op & COMPOUND_POSTFIX) ? (isAdd ? "++" : "--") : (isAdd ? "+=" : "-="));
+    if (instruction == OpCode::OP_COMPOUND_PROPERTY) {
+      printf(" cache(%d)", *offset << 8 | *(offset + 1));
+      offset += 2;
+    }
+    printf("\n");
+  }
+void ChunkDebugger::captureOperands(
+  const ObjFunc* function,
+  const Chunk& chunk,
+  typeVMCodeArray::const_iterator& offset) {
+    for (uint32_t i = 0; i < function->upvalueCount; i++) {
+      const auto addrPos = offset - chunk.code.cbegin();
+      auto kind = *offset++;
+      int index = *offset++;
+      if (kind & CAPTURE_WIDE) index = index << 8 | *offset++;
+      kind &= ~CAPTURE_WIDE;
+      printf("%04ld    |                     %s %d\n", addrPos, kind == CAPTURE_UPVALUE ? "upvalue" : kind == CAPTURE_LOCAL ? "local" : "value", index);
+    }
+  }
+const char* ChunkDebugger::opcodeName(OpCodeType instruction) {
+  switch (instruction) {
+    case OpCode::OP_CONSTANT: return "OP_CONSTANT";
+    case OpCode::OP_RETURN: return "OP_RETURN";
+    case OpCode::OP_NEGATE: return "OP_NEGATE";
+    case OpCode::OP_ADD: return "OP_ADD";
+    case OpCode::OP_SUBTRACT: return "OP_SUBTRACT";
+    case OpCode::OP_MULTIPLY: return "OP_MULTIPLY";
+    case OpCode::OP_DIVIDE: return "OP_DIVIDE";
+    case OpCode::OP_NIL: return "OP_NIL";
+    case OpCode::OP_TRUE: return "OP_TRUE";
+    case OpCode::OP_FALSE: return "OP_FALSE";
+    case OpCode::OP_NOT: return "OP_NOT";
+    case OpCode::OP_EQUAL: return "OP_EQUAL";
+    case OpCode::OP_GREATER: return "OP_GREATER";
+    case OpCode::OP_LESS: return "OP_LESS";
+    case OpCode::OP_POP: return "OP_POP";
+    case OpCode::OP_DEFINE_GLOBAL: return "OP_DEFINE_GLOBAL";
+    case OpCode::OP_GET_GLOBAL: return "OP_GET_GLOBAL";
+    case OpCode::OP_SET_GLOBAL: return "OP_SET_GLOBAL";
+    case OpCode::OP_GET_LOCAL: return "OP_GET_LOCAL";
+    case OpCode::OP_SET_LOCAL: return "OP_SET_LOCAL";
+    case OpCode::OP_JUMP_IF_FALSE: return "OP_JUMP_IF_FALSE";
+    case OpCode::OP_JUMP: return "OP_JUMP";
+    case OpCode::OP_LOOP: return "OP_LOOP";
+    case OpCode::OP_CALL: return "OP_CALL";
+    case OpCode::OP_CLOSURE: return "OP_CLOSURE";
+    case OpCode::OP_GET_UPVALUE: return "OP_GET_UPVALUE";
+    case OpCode::OP_SET_UPVALUE: return "OP_SET_UPVALUE";
+    case OpCode::OP_CLOSE_UPVALUE: return "OP_CLOSE_UPVALUE";
+    case OpCode::OP_CLASS: return "OP_CLASS";
+    case OpCode::OP_SET_PROPERTY: return "OP_SET_PROPERTY";
+    case OpCode::OP_GET_PROPERTY: return "OP_GET_PROPERTY";
+    case OpCode::OP_METHOD: return "OP_METHOD";
+    case OpCode::OP_INVOKE: return "OP_INVOKE";
+    case OpCode::OP_INHERIT: return "OP_INHERIT";
+    case OpCode::OP_GET_SUPER: return "OP_GET_SUPER";
+    case OpCode::OP_SUPER_INVOKE: return "OP_SUPER_INVOKE";
+    case OpCode::OP_MOVE: return "OP_MOVE";
+    case OpCode::OP_LOAD_CONSTANT: return "OP_LOAD_CONSTANT";
+    case OpCode::OP_ADD_RR: return "OP_ADD_RR";
+    case OpCode::OP_SUBTRACT_RR: return "OP_SUBTRACT_RR";
+    case OpCode::OP_MULTIPLY_RR: return "OP_MULTIPLY_RR";
+    case OpCode::OP_DIVIDE_RR: return "OP_DIVIDE_RR";
+    case OpCode::OP_ADD_RK: return "OP_ADD_RK";
+    case OpCode::OP_SUBTRACT_RK: return "OP_SUBTRACT_RK";
+    case OpCode::OP_MULTIPLY_RK: return "OP_MULTIPLY_RK";
+    case OpCode::OP_DIVIDE_RK: return "OP_DIVIDE_RK";
+    case OpCode::OP_JUMP_IF_NOT_LESS_RR: return "OP_JUMP_IF_NOT_LESS_RR";
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RR: return "OP_JUMP_IF_NOT_GREATER_RR";
+    case OpCode::OP_JUMP_IF_NOT_LESS_RK: return "OP_JUMP_IF_NOT_LESS_RK";
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RK: return "OP_JUMP_IF_NOT_GREATER_RK";
+    case OpCode::OP_ADD_LOCAL_LOCAL: return "OP_ADD_LOCAL_LOCAL";
+    case OpCode::OP_ADD_LOCAL_CONSTANT: return "OP_ADD_LOCAL_CONSTANT";
+    case OpCode::OP_SUBTRACT_LOCAL_CONSTANT: return "OP_SUBTRACT_LOCAL_CONSTANT";
+    case OpCode::OP_LESS_LOCAL_CONSTANT: return "OP_LESS_LOCAL_CONSTANT";
+    case OpCode::OP_SET_LOCAL_POP: return "OP_SET_LOCAL_POP";
+    case OpCode::OP_CALL_GLOBAL: return "OP_CALL_GLOBAL";
+    case OpCode::OP_POP_JUMP_IF_FALSE: return "OP_POP_JUMP_IF_FALSE";
+    case OpCode::OP_ADD_NUM: return "OP_ADD_NUM";
+    case OpCode::OP_ADD_STR: return "OP_ADD_STR";
+    case OpCode::OP_GET_GLOBAL_DEFINED: return "OP_GET_GLOBAL_DEFINED";
+    case OpCode::OP_TAIL_CALL: return "OP_TAIL_CALL";
+    case OpCode::OP_FOR_LOOP_LESS_RR: return "OP_FOR_LOOP_LESS_RR";
+    case OpCode::OP_FOR_LOOP_GREATER_RR: return "OP_FOR_LOOP_GREATER_RR";
+    case OpCode::OP_FOR_LOOP_LESS_RK: return "OP_FOR_LOOP_LESS_RK";
+    case OpCode::OP_FOR_LOOP_GREATER_RK: return "OP_FOR_LOOP_GREATER_RK";
+    case OpCode::OP_COMPOUND_LOCAL: return "OP_COMPOUND_LOCAL";
+    case OpCode::OP_COMPOUND_UPVALUE: return "OP_COMPOUND_UPVALUE";
+    case OpCode::OP_COMPOUND_GLOBAL: return "OP_COMPOUND_GLOBAL";
+    case OpCode::OP_COMPOUND_PROPERTY: return "OP_COMPOUND_PROPERTY";
+    case OpCode::OP_GET_CAPTURED: return "OP_GET_CAPTURED";
+    case OpCode::OP_CONSTANT_LONG: return "OP_CONSTANT_LONG";
+    case OpCode::OP_JUMP_LONG: return "OP_JUMP_LONG";
+    case OpCode::OP_JUMP_IF_FALSE_LONG: return "OP_JUMP_IF_FALSE_LONG";
+    case OpCode::OP_LOOP_LONG: return "OP_LOOP_LONG";
+    case OpCode::OP_WIDE: return "OP_WIDE";
+    case OpCode::OP_INTRINSIC: return "OP_INTRINSIC";
+    case OpCode::OP_SWITCH_TABLE: return "OP_SWITCH_TABLE";
+    case OpCode::OP_SWITCH_HASH: return "OP_SWITCH_HASH";
+    case OpCode::OP_TAIL_INVOKE: return "OP_TAIL_INVOKE";
+    case OpCode::OP_TAIL_SUPER_INVOKE: return "OP_TAIL_SUPER_INVOKE";
+    default: return "UNKNOWN";
+  }
+}
 void ChunkDebugger::disassembleInstruction(const Chunk& chunk, typeVMCodeArray::const_iterator& offset) {
   const auto offsetPos = offset - chunk.code.cbegin();
   printf("%04ld ", offsetPos);  // Print the offset location.
@@ -56,59 +363,126 @@ void ChunkDebugger::disassembleInstruction(const Chunk& chunk, typeVMCodeArray::
     printf("%4zu ", chunk.getLine(offsetPos));  // Print line information.
   }
   const auto instruction = *offset;
+  const auto name = opcodeName(instruction);
   switch (instruction) {  // Instructions have different sizes. 
-    case OpCode::OP_CONSTANT: return constantInstruction("OP_CONSTANT", chunk, offset);
-    case OpCode::OP_DEFINE_GLOBAL: return constantInstruction("OP_DEFINE_GLOBAL", chunk, offset);
-    case OpCode::OP_GET_GLOBAL: return constantInstruction("OP_GET_GLOBAL", chunk, offset);
-    case OpCode::OP_SET_GLOBAL: return constantInstruction("OP_SET_GLOBAL", chunk, offset);
-    case OpCode::OP_CLASS: return constantInstruction("OP_SET_GLOBAL", chunk, offset);
-    case OpCode::OP_GET_PROPERTY: return constantInstruction("OP_GET_PROPERTY", chunk, offset);
-    case OpCode::OP_SET_PROPERTY: return constantInstruction("OP_SET_PROPERTY", chunk, offset);
-    case OpCode::OP_METHOD: return constantInstruction("OP_METHOD", chunk, offset);
-    case OpCode::OP_GET_SUPER: return constantInstruction("OP_GET_SUPER", chunk, offset);
-    case OpCode::OP_SET_LOCAL: return byteInstruction("OP_SET_LOCAL", "index", offset);
-    case OpCode::OP_GET_LOCAL: return byteInstruction("OP_GET_LOCAL", "index", offset);
-    case OpCode::OP_CALL: return byteInstruction("OP_CALL", "argno", offset);
-    case OpCode::OP_NIL: return simpleInstruction("OP_NIL", offset);
-    case OpCode::OP_TRUE: return simpleInstruction("OP_TRUE", offset);
-    case OpCode::OP_FALSE: return simpleInstruction("OP_FALSE", offset);
-    case OpCode::OP_ADD: return simpleInstruction("OP_ADD", offset);
-    case OpCode::OP_SUBTRACT: return simpleInstruction("OP_SUBTRACT", offset);
-    case OpCode::OP_MULTIPLY: return simpleInstruction("OP_MULTIPLY", offset);
-    case OpCode::OP_DIVIDE: return simpleInstruction("OP_DIVIDE", offset);
-    case OpCode::OP_NEGATE:  return simpleInstruction("OP_NEGATE", offset);
-    case OpCode::OP_RETURN: return simpleInstruction("OP_RETURN", offset);
-    case OpCode::OP_NOT: return simpleInstruction("OP_NOT", offset);
-    case OpCode::OP_EQUAL: return simpleInstruction("OP_EQUAL", offset);
-    case OpCode::OP_GREATER: return simpleInstruction("OP_GREATER", offset);
-    case OpCode::OP_LESS: return simpleInstruction("OP_LESS", offset);
-    case OpCode::OP_POP: return simpleInstruction("OP_POP", offset);
-    case OpCode::OP_INHERIT: return simpleInstruction("OP_INHERIT", offset);
-    case OpCode::OP_JUMP: return jumpInstruction("OP_JUMP", 1, chunk, offset);
-    case OpCode::OP_JUMP_IF_FALSE: return jumpInstruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
-    case OpCode::OP_LOOP: return jumpInstruction("OP_LOOP", -1, chunk, offset);
+    case OpCode::OP_CONSTANT: return constantInstruction(name, chunk, offset);
+    case OpCode::OP_DEFINE_GLOBAL: return globalInstruction(name, offset);
+    case OpCode::OP_GET_GLOBAL: return globalInstruction(name, offset);
+    case OpCode::OP_SET_GLOBAL: return globalInstruction(name, offset);
+    case OpCode::OP_CLASS: return constantInstruction(name, chunk, offset);
+    case OpCode::OP_GET_PROPERTY: return propertyInstruction(name, chunk, offset);
+    case OpCode::OP_SET_PROPERTY: return constantInstruction(name, chunk, offset);
+    case OpCode::OP_METHOD: return constantInstruction(name, chunk, offset);
+    case OpCode::OP_GET_SUPER: return constantInstruction(name, chunk, offset);
+    case OpCode::OP_SET_LOCAL: return byteInstruction(name, "index", offset);
+    case OpCode::OP_GET_LOCAL: return byteInstruction(name, "index", offset);
+    case OpCode::OP_CALL: return callInstruction(name, offset);
+    case OpCode::OP_NIL: return simpleInstruction(name, offset);
+    case OpCode::OP_TRUE: return simpleInstruction(name, offset);
+    case OpCode::OP_FALSE: return simpleInstruction(name, offset);
+    case OpCode::OP_ADD: return simpleInstruction(name, offset);
+    case OpCode::OP_SUBTRACT: return simpleInstruction(name, offset);
+    case OpCode::OP_MULTIPLY: return simpleInstruction(name, offset);
+    case OpCode::OP_DIVIDE: return simpleInstruction(name, offset);
+    case OpCode::OP_NEGATE:  return simpleInstruction(name, offset);
+    case OpCode::OP_RETURN: return simpleInstruction(name, offset);
+    case OpCode::OP_NOT: return simpleInstruction(name, offset);
+    case OpCode::OP_EQUAL: return simpleInstruction(name, offset);
+    case OpCode::OP_GREATER: return simpleInstruction(name, offset);
+    case OpCode::OP_LESS: return simpleInstruction(name, offset);
+    case OpCode::OP_POP: return simpleInstruction(name, offset);
+    case OpCode::OP_INHERIT: return simpleInstruction(name, offset);
+    case OpCode::OP_JUMP: return jumpInstruction(name, 1, chunk, offset);
+    case OpCode::OP_JUMP_IF_FALSE: return jumpInstruction(name, 1, chunk, offset);
+    case OpCode::OP_LOOP: return jumpInstruction(name, -1, chunk, offset);
     case OpCode::OP_CLOSURE: {
       offset++;
       const auto constantIdx = *offset++;
       const auto& constant = chunk.constants[constantIdx];
-      printf("%-16s %4d ", "OP_CLOSURE", constantIdx);
+      printf("%-16s %4d ", name, constantIdx);
       printValue(constant);
       printf("\n");
-      const auto function = retrieveObjFunc(std::get<Obj*>(constant));
-      for (uint32_t i = 0; i < function->upvalueCount; i++) {
-        auto isLocal = *offset++;
-        auto index = *offset++; 
-        const auto addrPos = offset - 2 - chunk.code.cbegin();
-        printf("%04ld    |                     %s %d\n", addrPos, isLocal == 1 ? "local" : "upvalue", index);
+      return captureOperands(retrieveObjFunc(constant.asObj()), chunk, offset);
+    }
+    case OpCode::OP_GET_UPVALUE: return byteInstruction(name, "index", offset);
+    case OpCode::OP_SET_UPVALUE: return byteInstruction(name, "index", offset);
+    case OpCode::OP_GET_CAPTURED: return byteInstruction(name, "index", offset);
+    case OpCode::OP_CLOSE_UPVALUE: return simpleInstruction(name, offset);
+    case OpCode::OP_INVOKE: return invokeInstruction(name, chunk, offset);
+    case OpCode::OP_SUPER_INVOKE: return invokeInstruction(name, chunk, offset);
+    case OpCode::OP_MOVE: return registerInstruction(name, "rr", chunk, offset);
+    case OpCode::OP_LOAD_CONSTANT: return registerInstruction(name, "rk", chunk, offset);
+    case OpCode::OP_ADD_RR: return registerInstruction(name, "rrr", chunk, offset);
+    case OpCode::OP_SUBTRACT_RR: return registerInstruction(name, "rrr", chunk, offset);
+    case OpCode::OP_MULTIPLY_RR: return registerInstruction(name, "rrr", chunk, offset);
+    case OpCode::OP_DIVIDE_RR: return registerInstruction(name, "rrr", chunk, offset);
+    case OpCode::OP_ADD_RK: return registerInstruction(name, "rrk", chunk, offset);
+    case OpCode::OP_SUBTRACT_RK: return registerInstruction(name, "rrk", chunk, offset);
+    case OpCode::OP_MULTIPLY_RK: return registerInstruction(name, "rrk", chunk, offset);
+    case OpCode::OP_DIVIDE_RK: return registerInstruction(name, "rrk", chunk, offset);
+    case OpCode::OP_JUMP_IF_NOT_LESS_RR: return registerInstruction(name, "rrj", chunk, offset);
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RR: return registerInstruction(name, "rrj", chunk, offset);
+    case OpCode::OP_JUMP_IF_NOT_LESS_RK: return registerInstruction(name, "rkj", chunk, offset);
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RK: return registerInstruction(name, "rkj", chunk, offset);
+    case OpCode::OP_ADD_LOCAL_LOCAL: return registerInstruction(name, "rr", chunk, offset);
+    case OpCode::OP_ADD_LOCAL_CONSTANT: return registerInstruction(name, "rk", chunk, offset);
+    case OpCode::OP_SUBTRACT_LOCAL_CONSTANT: return registerInstruction(name, "rk", chunk, offset);
+    case OpCode::OP_LESS_LOCAL_CONSTANT: return registerInstruction(name, "rk", chunk, offset);
+    case OpCode::OP_SET_LOCAL_POP: return byteInstruction(name, "index", offset);
+    case OpCode::OP_CALL_GLOBAL: return callInstruction(name, offset);
+    case OpCode::OP_POP_JUMP_IF_FALSE: return jumpInstruction(name, 1, chunk, offset);
+    case OpCode::OP_ADD_NUM: return simpleInstruction(name, offset);
+    case OpCode::OP_ADD_STR: return simpleInstruction(name, offset);
+    case OpCode::OP_GET_GLOBAL_DEFINED: return globalInstruction(name, offset);
+    case OpCode::OP_TAIL_CALL: return callInstruction(name, offset);
+    case OpCode::OP_FOR_LOOP_LESS_RR: return registerInstruction(name, "rrkb", chunk, offset);
+    case OpCode::OP_FOR_LOOP_GREATER_RR: return registerInstruction(name, "rrkb", chunk, offset);
+    case OpCode::OP_FOR_LOOP_LESS_RK: return registerInstruction(name, "rkkb", chunk, offset);
+    case OpCode::OP_FOR_LOOP_GREATER_RK: return registerInstruction(name, "rkkb", chunk, offset);
+    case OpCode::OP_COMPOUND_LOCAL: return compoundInstruction(name, chunk, offset);
+    case OpCode::OP_COMPOUND_UPVALUE: return compoundInstruction(name, chunk, offset);
+    case OpCode::OP_COMPOUND_GLOBAL: return compoundInstruction(name, chunk, offset);
+    case OpCode::OP_COMPOUND_PROPERTY: return compoundInstruction(name, chunk, offset);
+    case OpCode::OP_CONSTANT_LONG: {
+      const auto constantIdx = *(offset + 1) << 16 | *(offset + 2) << 8 | *(offset + 3);
+      printf("%-16s index(%4d); const('", name, constantIdx);
+      printValue(chunk.constants[constantIdx]);
+      printf("')\n");
+      offset += 4;
+      return;
+    }
+    case OpCode::OP_JUMP_LONG: return jumpInstruction(name, 1, chunk, offset);
+    case OpCode::OP_JUMP_IF_FALSE_LONG: return jumpInstruction(name, 1, chunk, offset);
+    case OpCode::OP_LOOP_LONG: return jumpInstruction(name, -1, chunk, offset);
+    case OpCode::OP_WIDE: {
+      const auto prefixed = *(offset + 1);
+      const auto index = *(offset + 2) << 8 | *(offset + 3);
+      const auto size = chunk.instructionSize(offset - chunk.code.cbegin());
+      printf("%-16s %s index(%4d)", name, opcodeName(prefixed), index);
+      if (prefixed == OpCode::OP_COMPOUND_LOCAL || prefixed == OpCode::OP_COMPOUND_UPVALUE) {
+        printf(" operand(%d)", *(offset + 4));  // The operator of "OP_COMPOUND_*".
+      } else if (Chunk::isNamed(prefixed)) {
+        printf("; const('");
+        printValue(chunk.constants[index]);
+        printf("')");
       }
+      printf("\n");
+      if (prefixed == OpCode::OP_CLOSURE) {
+        offset += 4;
+        return captureOperands(retrieveObjFunc(chunk.constants[index].asObj()), chunk, offset);
+      }
+      offset += size;
+      return;
+    }
+    case OpCode::OP_SWITCH_TABLE: return switchInstruction(name, chunk, offset);
+    case OpCode::OP_SWITCH_HASH: return switchInstruction(name, chunk, offset);
+    case OpCode::OP_TAIL_INVOKE: return invokeInstruction(name, chunk, offset);
+    case OpCode::OP_TAIL_SUPER_INVOKE: return invokeInstruction(name, chunk, offset);
+    case OpCode::OP_INTRINSIC: {
+      printf("%-16s %s\n", name, INTRINSICS[*(offset + 1)].name.data());
       offset += 2;
       return;
     }
-    case OpCode::OP_GET_UPVALUE: return byteInstruction("OP_GET_UPVALUE", "index", offset);
-    case OpCode::OP_SET_UPVALUE: return byteInstruction("OP_SET_UPVALUE", "index", offset);
-    case OpCode::OP_CLOSE_UPVALUE: return simpleInstruction("OP_CLOSE_UPVALUE", offset);
-    case OpCode::OP_INVOKE: return invokeInstruction("OP_INVOKE", chunk, offset);
-    case OpCode::OP_SUPER_INVOKE: return invokeInstruction("OP_SUPER_INVOKE", chunk, offset);
     default: {
       std::cout << "Unknow opcode: " << +instruction << '.' << std::endl;
       offset += 1;
@@ -15,14 +15,92 @@
 #include <ranges>
 #include <unordered_map>
 #include <utility>
+#include <functional>
 #include "./type.h"  
 
+struct ObjClass;
+struct ObjShape;
+struct Obj;
+struct ObjFunc;
+
+/**
+ * The per-instruction (polymorphic) inline cache of "OP_GET_PROPERTY", "OP_INVOKE" and "OP_SUPER_INVOKE".
+ * Each entry remembers what the lookup of the property name resolved to for a receiver of the given class and shape: -
+ * a field slot, or a method of the class (only valid while the class version is unchanged).
+ * Once more than "INLINE_CACHE_SIZE" receivers have been seen, the site goes megamorphic and stops caching.
+*/
+struct InlineCacheEntry {
+  ObjClass* klass;
+  ObjShape* shape;
+  uint32_t version;
+  uint32_t slot;  // Field slot, or "ObjShape::NO_SLOT" for a method.
+  Obj* method;
+};
+
+struct InlineCache {
+  uint8_t count = 0;
+  bool megamorphic = false;
+  InlineCacheEntry entries[INLINE_CACHE_SIZE];
+};
+
+/**
+ * The monomorphic cache of a call site ("OP_CALL", "OP_TAIL_CALL" and "OP_CALL_GLOBAL"), -
+ * the last function or closure it called, whose arity has been checked against the argument count of the site.
+*/
+struct CallCache {
+  Obj* callee = nullptr;
+  const ObjFunc* function = nullptr;
+};
+
+/**
+ * The cases of a "switch" statement, "OP_SWITCH_TABLE" indexes "targets" by the value, "OP_SWITCH_HASH" looks it up in "cases". -
+ * The targets are offsets into the code, moved along by the optimizer passes (see "ChunkRewriter::rewrite").
+*/
+struct SwitchTable {
+  std::vector<VMValue> labels;  // In source order, for GC and the disassembler.
+  std::unordered_map<uint64_t, size_t> cases;  // The bits of each label (see "key") -> target.
+  int32_t low = 0;  // The label of "targets[0]".
+  std::vector<size_t> targets;  // Dense integer labels only, the holes go to the default target.
+  size_t defaultTarget = 0;  // The default case, or the end of the statement.
+  /**
+   * A number which is integral takes the integer representation (and "-0" the one of "0"), -
+   * strings are interned, so equal values have equal bits.
+  */
+  static VMValue key(const VMValue& value) {
+    return value.isDouble() ? VMValue::number(value.asNumber() + 0.0) : value;
+  }
+  size_t denseTarget(const VMValue& value) const {
+    const auto label = key(value);
+    if (!label.isInt()) return defaultTarget;
+    const auto idx = static_cast<int64_t>(label.asInt()) - low;
+    return idx >= 0 && idx < static_cast<int64_t>(targets.size()) ? targets[idx] : defaultTarget;
+  }
+  size_t hashedTarget(const VMValue& value) const {
+    const auto found = cases.find(key(value).bits);
+    return found != cases.cend() ? found->second : defaultTarget;
+  }
+  void forEachTarget(const std::function<void(size_t)>& fn) const {
+    for (const auto& [_, target] : cases) fn(target);
+    for (const auto target : targets) fn(target);
+    fn(defaultTarget);
+  }
+  void relocate(const std::vector<size_t>& relocation) {  // Old offset -> new offset.
+    for (auto& [_, target] : cases) target = relocation[target];
+    for (auto& target : targets) target = relocation[target];
+    defaultTarget = relocation[defaultTarget];
+  }
+};
+
 struct Debugger;
 struct Chunk {
   friend struct Debugger;
   typeVMCodeArray code;  // A heterogeneous storage (saving both opcodes and operands).
-  typeRuntimeConstantArray constants;
+  typeVMConstantArray constants;
   std::vector<size_t> lines;  // Save line information with run-length encoding.
+  std::vector<InlineCache> caches;  // Indexed by the 16-bit cache operand of instructions.
+  std::vector<CallCache> callCaches;  // Indexed by the 16-bit cache operand of the calls.
+  std::unordered_map<size_t, size_t> farJumps;  // Jump instruction -> target, for the offsets which don't fit until widened.
+  std::vector<SwitchTable> switchTables;  // Indexed by the 16-bit operand of "OP_SWITCH_TABLE" and "OP_SWITCH_HASH".
   Chunk() = default;
   void addCode(const std::vector<std::pair<OpCodeType, size_t>>& snapshot) {
     for (auto it = snapshot.cbegin(); it != snapshot.cend(); ++it) {
@@ -44,6 +122,13 @@ struct Chunk {
       std::exit(EXIT_FAILURE);
     }
   }
+  void truncate(size_t size) {  // Drop the code from "size" on, with its line information.
+    code.resize(size);
+    while (lines.size() > 0 && (lines.size() == 2 ? 0 : *(lines.end() - 4) + 1) >= size) {
+      lines.resize(lines.size() - 2);
+    }
+    if (lines.size() > 0) *(lines.end() - 2) = size - 1;
+  }
   size_t getLine(const typeVMCodeArray::const_iterator& codeIt) const {
     const auto codeIdx = static_cast<size_t>(codeIt - code.cbegin());
     return getLine(codeIdx);
@@ -56,7 +141,7 @@ struct Chunk {
     }
     return 0;
   }
-  size_t addConstant(const typeRuntimeValue& v) {
+  size_t addConstant(const VMValue& v) {
     try {
       constants.emplace_back(v);
     } catch (const std::bad_alloc& e) {
@@ -64,18 +149,79 @@ struct Chunk {
     }
     return constants.size() - 1;  // Return the index to the appended value.
   }
+  size_t addInlineCache(void) {
+    caches.emplace_back();
+    return caches.size() - 1;
+  }
+  size_t addCallCache(void) {
+    callCaches.emplace_back();
+    return callCaches.size() - 1;
+  }
+  size_t addSwitchTable(void) {
+    switchTables.emplace_back();
+    return switchTables.size() - 1;
+  }
   void free(void) {
     code.clear();
     constants.clear();
+    caches.clear();
+    callCaches.clear();
+    switchTables.clear();
+  }
+  size_t instructionSize(size_t) const;  // The size (opcode and operands) of the instruction at the given offset.
+  size_t captureSize(size_t, size_t) const;  // The size of the captures of "OP_CLOSURE" from the offset, for the function constant.
+  /**
+   * Whether the first operand of "op" is a name or function constant, "OP_WIDE" widens it past the first "UINT8_COUNT" ones.
+  */
+  static bool isNamed(OpCodeType op) {
+    switch (op) {
+      case OpCode::OP_CLOSURE:
+      case OpCode::OP_CLASS:
+      case OpCode::OP_GET_PROPERTY:
+      case OpCode::OP_SET_PROPERTY:
+      case OpCode::OP_COMPOUND_PROPERTY:
+      case OpCode::OP_METHOD:
+      case OpCode::OP_INVOKE:
+      case OpCode::OP_TAIL_INVOKE:
+      case OpCode::OP_GET_SUPER:
+      case OpCode::OP_SUPER_INVOKE:
+      case OpCode::OP_TAIL_SUPER_INVOKE: return true;
+      default: return false;
+    }
+  }
+  /**
+   * The direction of the jump encoded by an instruction: 1 for forward, -1 for backward, 0 for none. 
+   * The jump offset is always the last operand bytes of the instruction (two, or four for the long forms), -
+   * and it's relative to the end of the instruction.
+  */
+  static int jumpDirection(OpCodeType);
+  static size_t jumpOperandSize(OpCodeType op) {
+    return op == OpCode::OP_JUMP_LONG || op == OpCode::OP_JUMP_IF_FALSE_LONG || op == OpCode::OP_LOOP_LONG ? 4 : 2;
+  }
+  size_t jumpOffset(size_t offset) const {  // The jump offset of the instruction at the given offset.
+    const auto end = offset + instructionSize(offset);
+    size_t jump = 0;
+    for (auto pos = end - jumpOperandSize(code[offset]); pos < end; pos++) {
+      jump = jump << 8 | code[pos];
+    }
+    return jump;
   }
 };
 
 struct ChunkDebugger {
+  static const char* opcodeName(OpCodeType);
   static void simpleInstruction(const char*, typeVMCodeArray::const_iterator&);
   static void constantInstruction(const char*, const Chunk&, typeVMCodeArray::const_iterator&);
   static void invokeInstruction(const char*, const Chunk&, typeVMCodeArray::const_iterator&);
+  static void propertyInstruction(const char*, const Chunk&, typeVMCodeArray::const_iterator&);
   static void byteInstruction(const char*, const char*, typeVMCodeArray::const_iterator&);
+  static void globalInstruction(const char*, typeVMCodeArray::const_iterator&);
+  static void callInstruction(const char*, typeVMCodeArray::const_iterator&);
+  static void switchInstruction(const char*, const Chunk&, typeVMCodeArray::const_iterator&);
   static void jumpInstruction(const char*, int, const Chunk&, typeVMCodeArray::const_iterator&);
+  static void registerInstruction(const char*, const char*, const Chunk&, typeVMCodeArray::const_iterator&);
+  static void compoundInstruction(const char*, const Chunk&, typeVMCodeArray::const_iterator&);
+  static void captureOperands(const ObjFunc*, const Chunk&, typeVMCodeArray::const_iterator&);
   static void disassembleInstruction(const Chunk&, typeVMCodeArray::const_iterator&);
   static void disassembleChunk(const Chunk&, const char*);
 };
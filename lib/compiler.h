@@ -4,9 +4,12 @@
 #include <string>
 #include <cstdlib>
 #include <array>
+#include <deque>
 #include <unordered_map>
 #include <cstdint>
 #include <optional>
+#include <algorithm>
+#include <ranges>
 #include "./common.h"
 #include "./chunk.h"
 #include "./token.h"
@@ -14,6 +17,8 @@
 #include "./constant.h"
 #include "./object.h"
 #include "./memory.h"
+#include "./optimizer.h"
+#include "./verifier.h"
 
 struct Compiler;
 using typeParseFn = void (Compiler::*)(bool);
@@ -49,11 +54,18 @@ struct Local {
   size_t depth;
   bool isCaptured = false;
   bool initialized = false;
+  bool reassigned = false;  // Assigned after its initialization, by this function or a closure.
+  bool isConst = false;  // Declared by "const", -
+  std::optional<VMValue> value;  // with the value its initializer folded into, which its reads load instead (see "namedVariable").
+  std::vector<size_t> captureOperands;  // The kind operands of the "OP_CLOSURE" instructions capturing it.
+  std::vector<std::pair<ObjFunc*, uint16_t>> upvalues;  // The functions (at any depth) referring to it, with their upvalue indices.
+  size_t shadowed = SIZE_MAX;  // The slot of the local with the same name it shadows, see "Compiler::namedLocals".
 };
 
 struct Upvalue {
-  uint8_t index;  // Which local slot the upvalue is capturing.
+  uint16_t index;  // Which local slot (or upvalue of the enclosing function) the upvalue is capturing.
   bool isLocal;
+  Local* origin;  // The captured local, in the compiler of the function declaring it.
 };
 
 struct Compiler {
@@ -61,13 +73,29 @@ struct Compiler {
   ObjFunc* compilingFunc = nullptr;
   FunctionScope compilingScope = FunctionScope::TYPE_TOP_LEVEL;
   InternedConstants* internedConstants;
-  Upvalue upvalues[UINT8_COUNT] = {};
-  Local locals[UINT8_COUNT] = {};  // All the in-scope locals.
+  GlobalSlots* globalSlots = nullptr;  // Shared with the VM, which owns the slot values.
+  std::vector<Upvalue> upvalues;
+  std::deque<Local> locals;  // All the in-scope locals (and the slots of ended scopes), a deque keeps "Upvalue::origin" valid.
   size_t localCount = 0;  // Tracks how many locals are in scope.
+  /**
+   * The slot of the latest in-scope local of each name, so resolving a name doesn't scan all the locals -
+   * (generated functions may have thousands). Ending a scope restores the ones its locals shadowed.
+  */
+  std::unordered_map<std::string_view, size_t> namedLocals;
+  std::unordered_map<uint32_t, uint16_t> upvalueIndices;  // (isLocal, index) -> upvalue, for reusing the existing upvalues.
+  size_t shortConstants = 0;  // How many of the constants "OP_CONSTANT" can address are taken, see "makeLiteral".
+  std::unordered_map<Obj*, size_t> nameConstants;  // Each name takes one constant, however many times it's used.
   size_t scopeDepth = 0;  // The number of blocks surrounding the current bit of code we’re compiling.
   std::vector<Token>::const_iterator current;
   std::vector<Token>& tokens;
   Compiler* enclosing;
+  size_t lastCallOffset = SIZE_MAX;  // Where the latest "OP_CALL", "OP_INVOKE" or "OP_SUPER_INVOKE" was emitted, for detecting tail calls.
+  size_t leftOperandStart = 0;  // Where the code of the left operand of the infix operator being compiled starts.
+  const Token* prefixTarget = nullptr;  // The last name of the target of the prefix "++" / "--" being compiled, -
+  OpCodeType prefixOp = OpCode::OP_ADD;  // and its operator.
+  size_t lastGlobalReadOffset = SIZE_MAX;  // Where the latest "OP_GET_GLOBAL" was emitted, -
+  std::optional<OpCodeType> lastGlobalReadIntrinsic;  // and the intrinsic named by it, for inlining the call (see "call").
+  bool registerMode = false;  // Lower stack code on locals into register instructions (see "optimizer.h").
   static ClassCompiler* currentClass;  // Point to a struct representing the current, innermost class being compiled.
   static std::unordered_map<std::string_view, Token> syntheticTokens;
   /**
@@ -82,6 +110,7 @@ struct Compiler {
     [TokenType::LEFT_BRACE] = { nullptr, nullptr, Precedence::PREC_NONE }, 
     [TokenType::RIGHT_BRACE] = {nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::COMMA] = { nullptr, nullptr, Precedence::PREC_NONE },
+    [TokenType::COLON] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::DOT] = { nullptr, &Compiler::dot, Precedence::PREC_CALL },
     [TokenType::MINUS] = { &Compiler::unary, &Compiler::binary, Precedence::PREC_TERM },
     [TokenType::PLUS] = { nullptr, &Compiler::binary, Precedence::PREC_TERM },
@@ -96,11 +125,18 @@ struct Compiler {
     [TokenType::GREATER_EQUAL] = { nullptr, &Compiler::binary, Precedence::PREC_COMPARISON },
     [TokenType::LESS] = { nullptr, &Compiler::binary, Precedence::PREC_COMPARISON },
     [TokenType::LESS_EQUAL] = { nullptr, &Compiler::binary, Precedence::PREC_COMPARISON },
+    [TokenType::MINUS_MINUS] = { &Compiler::unary, &Compiler::binary, Precedence::PREC_TERM },  // Postfix forms are compiled along with their targets.
+    [TokenType::MINUS_EQUAL] = { nullptr, nullptr, Precedence::PREC_NONE },
+    [TokenType::PLUS_PLUS] = { &Compiler::unary, nullptr, Precedence::PREC_NONE },
+    [TokenType::PLUS_EQUAL] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::IDENTIFIER] = { &Compiler::variable, nullptr, Precedence::PREC_NONE },
     [TokenType::STRING] = { &Compiler::string, nullptr, Precedence::PREC_NONE },
     [TokenType::NUMBER] = { &Compiler::number, nullptr, Precedence::PREC_NONE },
     [TokenType::AND] = { nullptr, &Compiler::and_, Precedence::PREC_AND },
+    [TokenType::CASE] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::CLASS] = { nullptr, nullptr, Precedence::PREC_NONE },
+    [TokenType::CONST] = { nullptr, nullptr, Precedence::PREC_NONE },
+    [TokenType::DEFAULT] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::ELSE] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::FALSE] = { &Compiler::literal, nullptr, Precedence::PREC_NONE },
     [TokenType::FOR] = { nullptr, nullptr, Precedence::PREC_NONE },
@@ -110,6 +146,7 @@ struct Compiler {
     [TokenType::OR] = { nullptr, &Compiler::or_, Precedence::PREC_OR },
     [TokenType::RETURN] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::SUPER] = { &Compiler::super_, nullptr, Precedence::PREC_NONE } ,
+    [TokenType::SWITCH] = { nullptr, nullptr, Precedence::PREC_NONE },
     [TokenType::THIS] = { &Compiler::this_, nullptr, Precedence::PREC_NONE },
     [TokenType::TRUE] = { &Compiler::literal, nullptr, Precedence::PREC_NONE },
     [TokenType::VAR] = { nullptr, nullptr, Precedence::PREC_NONE },
@@ -130,10 +167,15 @@ struct Compiler {
     current(tokenIt),
     tokens(tokens),
     enclosing(enclosingCompiler) {
+      if (enclosingCompiler != nullptr) {
+        registerMode = enclosingCompiler->registerMode;
+        globalSlots = enclosingCompiler->globalSlots;
+      }
       if (scope != FunctionScope::TYPE_TOP_LEVEL) {
         compilingFunc->name = internedConstants->add(previous().lexeme)->cast<ObjString>();
       }
-      Local* local = &locals[localCount++];  // Stack slot zero is for VM’s own internal use.
+      Local* local = &locals.emplace_back();  // Stack slot zero is for VM’s own internal use.
+      localCount++;
       local->depth = 0;
       if (scope == FunctionScope::TYPE_METHOD || scope == FunctionScope::TYPE_INITIALIZER) {
         local->name = &(syntheticTokens.find("this")->second);
@@ -141,6 +183,7 @@ struct Compiler {
       } else {
         local->name = nullptr;  // Empty name.
       }
+      if (local->name != nullptr) namedLocals[local->name->lexeme] = 0;
     }
   Compiler(const Compiler&) = delete;
   Compiler(const Compiler&&) = delete; 
@@ -188,15 +231,85 @@ struct Compiler {
     }
     emitByte(OpCode::OP_RETURN);
   }
-  void emitConstant(const typeRuntimeValue& value) {
-    emitBytes(OpCode::OP_CONSTANT, makeConstant(value));
+  void emitConstant(const VMValue& value) {
+    const auto constantIdx = makeLiteral(value);
+    if (constantIdx <= UINT8_MAX) {
+      emitBytes(OpCode::OP_CONSTANT, constantIdx);
+      return;
+    }
+    emitBytes(OpCode::OP_CONSTANT_LONG, (constantIdx >> 16) & 0xff);  // 24-bit index.
+    emitShort(constantIdx & 0xffff);
+  }
+  void emitValue(const VMValue& value) {  // The literals which have their own instructions don't take a constant.
+    if (value.isNil()) {
+      emitByte(OpCode::OP_NIL);
+    } else if (value.isBool()) {
+      emitByte(value.asBool() ? OpCode::OP_TRUE : OpCode::OP_FALSE);
+    } else {
+      emitConstant(value);
+    }
+  }
+  void emitShort(uint16_t operand) {
+    emitByte((operand >> 8) & 0xff);
+    emitByte(operand & 0xff);
+  }
+  void emitInlineCache(void) {
+    const auto cacheIdx = currentChunk().addInlineCache();
+    if (cacheIdx > UINT16_MAX) {
+      errorAtPrevious("too many property accesses in one chunk.");
+    }
+    emitShort(cacheIdx);
+  }
+  void emitCallCache(void) {
+    const auto cacheIdx = currentChunk().addCallCache();
+    if (cacheIdx > UINT16_MAX) {
+      errorAtPrevious("too many calls in one chunk.");
+    }
+    emitShort(cacheIdx);
+  }
+  /**
+   * Add a constant addressed by an 8-bit operand (names, functions of "OP_CLOSURE", the steps of counted loops). -
+   * Past the first "UINT8_COUNT" constants, the names and functions take a 16-bit one (see "emitNamed").
+  */
+  size_t makeConstant(const VMValue& value) {
+    auto& chunk = currentChunk();
+    if (shortConstants == UINT8_COUNT) {
+      if (chunk.constants.size() > UINT16_MAX) {
+        errorAtPrevious("too many constants in one chunk.");
+      }
+      return chunk.addConstant(value);
+    }
+    if (shortConstants == chunk.constants.size()) {
+      chunk.addConstant(value);
+    } else {
+      chunk.constants[shortConstants] = value;  // A slot "makeLiteral" left for the names.
+    }
+    return shortConstants++;
+  }
+  /**
+   * Emit "op" whose first operand is a name or function constant, prefixed by "OP_WIDE" for a 16-bit index.
+  */
+  void emitNamed(OpCodeType op, size_t constant) {
+    if (constant > UINT8_MAX) {
+      emitBytes(OpCode::OP_WIDE, op);
+      emitShort(constant);
+    } else {
+      emitBytes(op, constant);
+    }
   }
-  OpCodeType makeConstant(const typeRuntimeValue& value) {
-    auto constantIdx = currentChunk().addConstant(value);
-    if (constantIdx > UINT8_MAX) {
+  /**
+   * Add the constant of a literal, which is loaded by "OP_CONSTANT" or "OP_CONSTANT_LONG". -
+   * Past "SHORT_LITERALS_MAX" short constants, the literals go after the first "UINT8_COUNT" constants, -
+   * so a function with lots of literals still has room for the names it uses.
+  */
+  size_t makeLiteral(const VMValue& value) {
+    auto& chunk = currentChunk();
+    if (shortConstants < SHORT_LITERALS_MAX) return makeConstant(value);
+    if (chunk.constants.size() < UINT8_COUNT) chunk.constants.resize(UINT8_COUNT);  // Keep the rest of the short ones free.
+    if (chunk.constants.size() == CONSTANTS_MAX) {
       errorAtPrevious("too many constants in one chunk.");
     }
-    return static_cast<OpCodeType>(constantIdx);
+    return chunk.addConstant(value);
   }
   auto check(const TokenType& type) {
     return peek().type == type;
@@ -213,13 +326,15 @@ struct Compiler {
       errorAtPrevious("expect expression.");
     }
     const auto canAssign = precedence <= PREC_ASSIGNMENT;
+    const auto start = currentChunk().code.size();
     (this->*prefixRule)(canAssign);
     while (precedence <= getRule(peek().type)->precedence) {  // The prefix expression already compiled might be an operand for the infix operator.
       advance();
       auto infixRule = getRule(previous().type)->infix;
+      leftOperandStart = start;
       (this->*infixRule)(canAssign);
     }
-    if (canAssign && match(TokenType::EQUAL)) {
+    if (canAssign && (match(TokenType::EQUAL) || match(TokenType::PLUS_EQUAL) || match(TokenType::MINUS_EQUAL))) {
       errorAtPrevious("invalid assignment target.");
     }
   }
@@ -233,45 +348,79 @@ struct Compiler {
   /**
    * Mark the local variable as "initialized", or save it as a global at runtime.
   */
-  void defineVariable(std::optional<OpCodeType> varIdx) {
+  void defineVariable(std::optional<uint16_t> globalSlot) {
     if (scopeDepth > 0) {
       markInitialized();
       return;
     }
-    if (varIdx.has_value()) {
-      emitBytes(OpCode::OP_DEFINE_GLOBAL, varIdx.value());  // OpCode for defining the variable and storing its initial value.
+    if (globalSlot.has_value()) {
+      emitByte(OpCode::OP_DEFINE_GLOBAL);  // OpCode for defining the variable and storing its initial value.
+      emitShort(globalSlot.value());
     }
   }
   /**
    * Take the given token and add its lexeme to the chunk’s constant table as a string.
   */
   auto identifierConstant(const Token& token) {
-    return makeConstant(internedConstants->add(token.lexeme));
+    const auto name = internedConstants->add(token.lexeme);
+    const auto found = nameConstants.find(name);
+    if (found != nameConstants.end()) return found->second;
+    return nameConstants[name] = makeConstant(name);
+  }
+  /**
+   * Resolve the name of a global variable into its slot of the VM-wide global table.
+  */
+  uint16_t globalSlot(const Token& token) {
+    const auto slot = globalSlots->resolve(internedConstants->add(token.lexeme));
+    if (slot > UINT16_MAX) {
+      errorAtPrevious("too many global variables.");
+    }
+    return static_cast<uint16_t>(slot);
   }
   void addLocal(const Token* name) {
-    if (localCount == UINT8_COUNT) {
+    if (localCount == LOCALS_MAX) {
       errorAtPrevious("too many local variables in function.");
     }
-    auto& local = locals[localCount++];
+    if (localCount == locals.size()) locals.emplace_back();
+    auto& local = locals[localCount] = Local {};  // The slot may have been used by a local of an ended scope.
     local.name = name;
     local.depth = scopeDepth;
+    const auto [named, isFirst] = namedLocals.try_emplace(name->lexeme, localCount);
+    if (!isFirst) {
+      local.shadowed = named->second;
+      named->second = localCount;
+    }
+    localCount++;
+  }
+  void removeLocal(void) {
+    const auto& local = locals[--localCount];
+    if (local.name == nullptr) return;
+    if (local.shadowed == SIZE_MAX) {
+      namedLocals.erase(local.name->lexeme);
+    } else {
+      namedLocals[local.name->lexeme] = local.shadowed;
+    }
+  }
+  Local* findLocal(std::string_view name) {
+    const auto named = namedLocals.find(name);
+    return named == namedLocals.end() ? nullptr : &locals[named->second];
   }
   /**
    * Add variable as a local, and detect certain errors.
   */
   void declareVariable(void) {
-    if (scopeDepth == 0) return;
     const auto& name = previous();
+    if (scopeDepth == 0) {
+      if (globalSlots->constants.contains(globalSlot(name))) {
+        errorAtPrevious("already a constant with this name.");  // Globals may be redefined, but not the constant ones.
+      }
+      return;
+    }
 
     // Detect the error that having two variables with the same name in the same local scope.
-    for (auto i = localCount; i >= 1; i--) {
-      auto local = &locals[i - 1];
-      if ((local->initialized && local->depth < scopeDepth) || local->name == nullptr) {
-        break;
-      }
-      if (local->name->lexeme == name.lexeme) {
-        errorAtPrevious("already a variable with this name in this scope.");
-      }
+    const auto local = findLocal(name.lexeme);
+    if (local != nullptr && local->depth == scopeDepth) {
+      errorAtPrevious("already a variable with this name in this scope.");
     }
     addLocal(&name);
   }
@@ -280,40 +429,32 @@ struct Compiler {
     declareVariable();
     // Locals aren’t looked up by name. 
     return scopeDepth == 0 
-      ? std::make_optional(identifierConstant(previous())) 
+      ? std::make_optional(globalSlot(previous())) 
       : std::nullopt;
   }
-  std::optional<OpCodeType> resolveLocal(const Token& name) {
-    for (auto i = localCount; i >= 1; i--) {
-      const auto idx = i - 1;
-      const auto local = &locals[idx];
-      if (local->name != nullptr && (name.lexeme == local->name->lexeme)) {  // Find the last declared variable with the identifier.
-        if (!local->initialized) {
-          errorAtPrevious("can't read local variable in its own initializer.");
-        }
-        return std::make_optional(idx);
-      }
+  std::optional<uint16_t> resolveLocal(const Token& name) {
+    const auto named = namedLocals.find(name.lexeme);  // Find the last declared variable with the identifier.
+    if (named == namedLocals.end()) return std::nullopt;
+    if (!locals[named->second].initialized) {
+      errorAtPrevious("can't read local variable in its own initializer.");
     }
-    return std::nullopt;
+    return std::make_optional(named->second);
   }
-  OpCodeType addUpvalue(OpCodeType index, bool isLocal) {
+  uint16_t addUpvalue(uint16_t index, bool isLocal, Local* origin) {
     const auto upvalueCount = compilingFunc->upvalueCount;
 
     // Search and reuse the existing upvalues.
-    for (uint32_t i = 0; i < upvalueCount; i++) {
-      auto upvalue = &upvalues[i];
-      if (upvalue->index == index && upvalue->isLocal == isLocal) {
-        return i;
-      }
-    }
-    if (upvalueCount == UINT8_COUNT) {
+    const auto [existing, isNew] = upvalueIndices.try_emplace(static_cast<uint32_t>(isLocal) << 16 | index, upvalueCount);
+    if (!isNew) return existing->second;
+    if (upvalueCount == LOCALS_MAX) {
       errorAtPrevious("too many closure variables in function.");
+      return 0;
     }
-    upvalues[upvalueCount].isLocal = isLocal;
-    upvalues[upvalueCount].index = index;
+    upvalues.push_back(Upvalue { index, isLocal, origin });
+    origin->upvalues.emplace_back(compilingFunc, upvalueCount);
     return compilingFunc->upvalueCount++;  // Return the index of the upvalue.
   }
-  std::optional<OpCodeType> resolveUpvalue(const Token& name) {
+  std::optional<uint16_t> resolveUpvalue(const Token& name) {
     /**
      * Compiler: upvalue [isLocal, index].
      * VM: UpvalueObj [next, location], will be managed in a sorted linked list.
@@ -337,7 +478,7 @@ struct Compiler {
     if (local.has_value()) {
       const auto localIdx = local.value();
       enclosing->locals[localIdx].isCaptured = true;
-      return addUpvalue(localIdx, true);
+      return addUpvalue(localIdx, true, &enclosing->locals[localIdx]);
     }
     /**
      * This series of "resolveUpvalue()" calls works its way along the chain of nested compilers -
@@ -345,35 +486,113 @@ struct Compiler {
     */
     const auto upvalue = enclosing->resolveUpvalue(name);
     if (upvalue.has_value()) {
-      return addUpvalue(upvalue.value(), false);
+      return addUpvalue(upvalue.value(), false, enclosing->upvalues[upvalue.value()].origin);
+    }
+    return std::nullopt;
+  }
+  /**
+   * Compile the right operand of "+=" / "-=", or a constant one for a prefix or postfix "++" / "--", -
+   * and return the "operator" operand of the read-modify-write instruction (nothing if there is no such operator).
+  */
+  std::optional<OpCodeType> compoundAssignment(bool canAssign) {
+    if (&previous() == prefixTarget) {  // Evaluates to the new value.
+      prefixTarget = nullptr;
+      emitConstant(VMValue::integer(1));
+      return prefixOp;
+    }
+    if (canAssign && (match(TokenType::PLUS_EQUAL) || match(TokenType::MINUS_EQUAL))) {
+      const OpCodeType op = previous().type == TokenType::PLUS_EQUAL ? OpCode::OP_ADD : OpCode::OP_SUBTRACT;
+      expression();
+      return op;
+    }
+    if (match(TokenType::PLUS_PLUS) || (!isMinusNegate() && match(TokenType::MINUS_MINUS))) {  // Postfix, applies to any target expression.
+      const OpCodeType op = previous().type == TokenType::PLUS_PLUS ? OpCode::OP_ADD : OpCode::OP_SUBTRACT;
+      emitConstant(VMValue::integer(1));
+      return op | COMPOUND_POSTFIX;
     }
     return std::nullopt;
   }
+  /**
+   * The folded value of the constant a name refers to, looked up like "resolveLocal" and "resolveUpvalue" do -
+   * (so reading a constant of an enclosing function doesn't capture it), then in the globals.
+  */
+  std::optional<VMValue> constantValue(const Token& name) {
+    for (auto compiler = this; compiler != nullptr; compiler = compiler->enclosing) {
+      const auto local = compiler->findLocal(name.lexeme);
+      if (local != nullptr) return local->initialized ? local->value : std::nullopt;
+    }
+    const auto global = globalSlots->constants.find(globalSlot(name));
+    return global != globalSlots->constants.end() ? global->second : std::nullopt;
+  }
+  bool assignmentFollows(bool canAssign) {
+    return &previous() == prefixTarget || (canAssign && (check(TokenType::EQUAL) || check(TokenType::PLUS_EQUAL) || check(TokenType::MINUS_EQUAL))) ||
+      check(TokenType::PLUS_PLUS) || (check(TokenType::MINUS_MINUS) && !isMinusNegate());
+  }
+  bool isMinusNegate(void) {  // The "--" after an operand, see "startsPrimary".
+    return check(TokenType::MINUS_MINUS) && startsPrimary((current + 1)->type);
+  }
   void namedVariable(const Token& name, bool canAssign) {
-    OpCodeType setOp, getOp, varIndex;
+    if (!assignmentFollows(canAssign)) {
+      const auto constant = constantValue(name);
+      if (constant.has_value()) {
+        emitValue(constant.value());  // Propagated, the value is known at compile time.
+        return;
+      }
+    }
+    OpCodeType setOp, getOp, compoundOp;
+    uint16_t varIndex;
+    bool isConst;
     auto local = resolveLocal(name);
     if (local.has_value()) {
       // Looking for a local variable declared in the current function's scope.
       varIndex = local.value(); 
       getOp = OpCode::OP_GET_LOCAL;
       setOp = OpCode::OP_SET_LOCAL;
+      compoundOp = OpCode::OP_COMPOUND_LOCAL;
+      isConst = locals[varIndex].isConst;
     } else if ((local = resolveUpvalue(name)).has_value()) {  // Returning the "upvalue index".
       // Looking for a local variable declared in any of the surrounding functions.
       varIndex = local.value(); 
       getOp = OpCode::OP_GET_UPVALUE;
       setOp = OpCode::OP_SET_UPVALUE;
+      compoundOp = OpCode::OP_COMPOUND_UPVALUE;
+      isConst = upvalues[varIndex].origin->isConst;
     } else {
       // Looking for a local variable declared in the top-level function.
-      varIndex = identifierConstant(name);
+      varIndex = globalSlot(name);
       getOp = OpCode::OP_GET_GLOBAL;
       setOp = OpCode::OP_SET_GLOBAL;
+      compoundOp = OpCode::OP_COMPOUND_GLOBAL;
+      isConst = globalSlots->constants.contains(varIndex);
+    }
+    if (isConst && assignmentFollows(canAssign)) {
+      throw TokenError { name, "can't assign to a constant." };
     }
+    std::optional<OpCodeType> compound;
+    auto op = getOp;
     if (canAssign && match(TokenType::EQUAL)) {
       expression();
-      emitBytes(setOp, varIndex);
+      op = setOp;
+    } else if ((compound = compoundAssignment(canAssign)).has_value()) {
+      op = compoundOp;
+    }
+    const auto assigned = op != getOp;
+    if (assigned && setOp == OpCode::OP_SET_LOCAL) locals[varIndex].reassigned = true;
+    if (assigned && setOp == OpCode::OP_SET_UPVALUE) upvalues[varIndex].origin->reassigned = true;
+    if (assigned && setOp == OpCode::OP_SET_GLOBAL) globalSlots->assignments.try_emplace(varIndex, &name);
+    const auto wide = getOp != OpCode::OP_GET_GLOBAL && varIndex > UINT8_MAX;
+    if (wide) emitByte(OpCode::OP_WIDE);  // Locals and upvalues past the first "UINT8_COUNT" ones.
+    if (op == OpCode::OP_GET_GLOBAL) {
+      lastGlobalReadOffset = currentChunk().code.size();
+      lastGlobalReadIntrinsic = findIntrinsic(name.lexeme);
+    }
+    emitByte(op);
+    if (getOp == OpCode::OP_GET_GLOBAL || wide) {
+      emitShort(varIndex);  // Global slots are 16-bit.
     } else {
-      emitBytes(getOp, varIndex);
+      emitByte(varIndex);
     }
+    if (compound.has_value()) emitByte(compound.value());
   }
   /**
    * Takes the previously consumed token, treats it as a variable reference, - 
@@ -387,18 +606,131 @@ struct Compiler {
     emitConstant(internedConstants->add(str));
   }
   void number(bool) {
-    emitConstant(previous().literal);  // Number constant has been consumed.
+    emitConstant(VMValue::number(std::get<typeRuntimeNumericValue>(previous().literal)));  // Number constant has been consumed.
   }
   void grouping(bool) {
     expression();  // The opening '(' has been consumed.
     consume(TokenType::RIGHT_PAREN, "expect ')' after expression.");
   }
+  /**
+   * The value loaded by the code from "start" to "end", if it's a single constant load.
+  */
+  std::optional<VMValue> loadedConstant(size_t start, size_t end) {
+    const auto& chunk = currentChunk();
+    if (start >= end || start + chunk.instructionSize(start) != end) return std::nullopt;
+    switch (chunk.code[start]) {
+      case OpCode::OP_NIL: return VMValue {};
+      case OpCode::OP_TRUE: return VMValue { true };
+      case OpCode::OP_FALSE: return VMValue { false };
+      case OpCode::OP_CONSTANT: return chunk.constants[chunk.code[start + 1]];
+      case OpCode::OP_CONSTANT_LONG: return chunk.constants[chunk.code[start + 1] << 16 | chunk.code[start + 2] << 8 | chunk.code[start + 3]];
+      default: return std::nullopt;
+    }
+  }
+  /**
+   * Drop the code from "start" on, which loads constant operands. -
+   * The constants the loads added last are taken back, so a chain of folds takes a single one.
+  */
+  void discardConstantLoads(size_t start) {
+    auto& chunk = currentChunk();
+    std::vector<size_t> loaded;
+    for (auto offset = start; offset < chunk.code.size(); offset += chunk.instructionSize(offset)) {
+      if (chunk.code[offset] == OpCode::OP_CONSTANT) loaded.push_back(chunk.code[offset + 1]);
+    }
+    chunk.truncate(start);
+    for (const auto idx : loaded | std::views::reverse) {
+      if (idx + 1 != chunk.constants.size() || idx + 1 != shortConstants) break;
+      chunk.constants.pop_back();
+      shortConstants--;
+    }
+  }
+  void replaceWithConstant(size_t start, const VMValue& result) {  // Load the folded "result" instead.
+    discardConstantLoads(start);
+    emitValue(result);
+  }
+  static bool isFalsey(const VMValue& v) {
+    return v.isNil() || (v.isBool() && !v.asBool());
+  }
+  /**
+   * Compile-time evaluation of an operator on constant operands, the same way the VM evaluates it. -
+   * The operations which would fail at runtime aren't folded, so they still report their errors.
+  */
+  static std::optional<VMValue> foldUnary(TokenType opType, const VMValue& x) {
+    switch (opType) {
+      case TokenType::MINUS: return x.isNumber() ? std::make_optional(numberNegate(x)) : std::nullopt;
+      case TokenType::MINUS_MINUS: return x.isNumber() ? std::make_optional(numberNegate(numberNegate(x))) : std::nullopt;
+      case TokenType::BANG: return VMValue { isFalsey(x) };
+      default: return std::nullopt;
+    }
+  }
+  std::optional<VMValue> foldBinary(TokenType opType, const VMValue& x, const VMValue& y) {
+    const auto numbers = x.isNumber() && y.isNumber();
+    switch (opType) {
+      case TokenType::PLUS: {
+        if (numbers) return numberAdd(x, y);
+        if (!isObjStringValue(x) || !isObjStringValue(y)) return std::nullopt;
+        return internedConstants->add(x.asObj()->cast<ObjString>()->str + y.asObj()->cast<ObjString>()->str);
+      }
+      case TokenType::MINUS: return numbers ? std::make_optional(numberSubtract(x, y)) : std::nullopt;
+      case TokenType::MINUS_MINUS: return numbers ? std::make_optional(numberSubtract(x, numberNegate(y))) : std::nullopt;
+      case TokenType::STAR: return numbers ? std::make_optional(numberMultiply(x, y)) : std::nullopt;
+      case TokenType::SLASH: return numbers ? std::make_optional(numberDivide(x, y)) : std::nullopt;
+      case TokenType::BANG_EQUAL: return VMValue { !(x == y) };
+      case TokenType::EQUAL_EQUAL: return VMValue { x == y };
+      case TokenType::GREATER: return numbers ? std::make_optional(VMValue { numberGreater(x, y) }) : std::nullopt;
+      case TokenType::GREATER_EQUAL: return numbers ? std::make_optional(VMValue { !numberLess(x, y) }) : std::nullopt;
+      case TokenType::LESS: return numbers ? std::make_optional(VMValue { numberLess(x, y) }) : std::nullopt;
+      case TokenType::LESS_EQUAL: return numbers ? std::make_optional(VMValue { !numberGreater(x, y) }) : std::nullopt;
+      default: return std::nullopt;
+    }
+  }
+  /**
+   * The last name of the operand of a prefix "++" / "--" (starting at the current token) if it can be assigned, -
+   * that is a variable or a property ("a", "a.b.c", "this.n"). Nothing if it's any other expression.
+  */
+  const Token* prefixTargetName(void) const {
+    const auto head = current->type;
+    if (head != TokenType::IDENTIFIER && head != TokenType::THIS && head != TokenType::SUPER) return nullptr;
+    auto it = current + 1;
+    size_t properties = 0;
+    while (it->type == TokenType::DOT && (it + 1)->type == TokenType::IDENTIFIER) {
+      it += 2;
+      properties++;
+    }
+    switch (it->type) {
+      case TokenType::DOT:
+      case TokenType::LEFT_PAREN:
+      case TokenType::PLUS_PLUS:
+      case TokenType::MINUS_MINUS: return nullptr;
+      default: ;
+    }
+    if ((head == TokenType::THIS && properties < 1) || (head == TokenType::SUPER && properties < 2)) return nullptr;
+    return &*(it - 1);
+  }
   void unary(bool) {  // "Prefix" expression.
     const auto& prevToken = previous();
     const auto line = prevToken.line;
+    if (prevToken.type == TokenType::PLUS_PLUS || prevToken.type == TokenType::MINUS_MINUS) {
+      const auto target = prefixTargetName();
+      if (target != nullptr) {  // Compiled along with the target, see "compoundAssignment".
+        prefixTarget = target;
+        prefixOp = prevToken.type == TokenType::PLUS_PLUS ? OpCode::OP_ADD : OpCode::OP_SUBTRACT;
+        parsePrecedence(Precedence::PREC_UNARY);
+        return;
+      }
+      if (prevToken.type == TokenType::PLUS_PLUS) errorAtPrevious("invalid assignment target.");
+    }
+    const auto operandStart = currentChunk().code.size();
     parsePrecedence(Precedence::PREC_UNARY);  // Compile the operand.
+    const auto operand = loadedConstant(operandStart, currentChunk().code.size());
+    const auto folded = operand.has_value() ? foldUnary(prevToken.type, operand.value()) : std::nullopt;
+    if (folded.has_value()) {
+      replaceWithConstant(operandStart, folded.value());
+      return;
+    }
     switch (prevToken.type) {
       case TokenType::MINUS: emitByte(OpCode::OP_NEGATE, line); break;
+      case TokenType::MINUS_MINUS: emitBytes(OpCode::OP_NEGATE, OpCode::OP_NEGATE); break;  // A value which can't be assigned is negated twice.
       case TokenType::BANG: emitByte(OpCode::OP_NOT, line); break;
       default: return;
     }
@@ -413,10 +745,23 @@ struct Compiler {
      * because the binary operators are left-associative. .e.g: 
      * 1 + 2 + 3 + 4 -> ((1 + 2) + 3) + 4.
     */
+    if (opType == TokenType::MINUS_MINUS && !startsPrimary(peek().type)) {
+      errorAtPrevious("invalid assignment target.");  // A postfix decrement of a value which can't be assigned.
+    }
+    const auto leftStart = leftOperandStart;
+    const auto rightStart = currentChunk().code.size();
     parsePrecedence(static_cast<Precedence>(rule->precedence + 1)); 
+    const auto left = loadedConstant(leftStart, rightStart);
+    const auto right = loadedConstant(rightStart, currentChunk().code.size());
+    const auto folded = left.has_value() && right.has_value() ? foldBinary(opType, left.value(), right.value()) : std::nullopt;
+    if (folded.has_value()) {
+      replaceWithConstant(leftStart, folded.value());
+      return;
+    }
     switch (opType) {
       case TokenType::PLUS: emitByte(OpCode::OP_ADD, line); break;
       case TokenType::MINUS: emitByte(OpCode::OP_SUBTRACT, line); break;
+      case TokenType::MINUS_MINUS: emitByte(OpCode::OP_NEGATE, line); emitByte(OpCode::OP_SUBTRACT, line); break;  // "a--b", a minus and a negation.
       case TokenType::STAR: emitByte(OpCode::OP_MULTIPLY, line); break;
       case TokenType::SLASH: emitByte(OpCode::OP_DIVIDE, line); break;
       case TokenType::BANG_EQUAL: emitByte(OpCode::OP_EQUAL); emitByte(OpCode::OP_NOT); break;
@@ -453,20 +798,46 @@ struct Compiler {
   void dot(bool canAssign) {
     consume(TokenType::IDENTIFIER, "expect property name after '.'.");
     const auto name = identifierConstant(previous());
+    std::optional<OpCodeType> compound;
     if (canAssign && match(TokenType::EQUAL)) {  
       expression();
-      emitBytes(OpCode::OP_SET_PROPERTY, name);
+      emitNamed(OpCode::OP_SET_PROPERTY, name);
+    } else if ((compound = compoundAssignment(canAssign)).has_value()) {
+      emitNamed(OpCode::OP_COMPOUND_PROPERTY, name);
+      emitByte(compound.value());
+      emitInlineCache();
     } else if(match(TokenType::LEFT_PAREN)) {
       const auto argCount = argumentList();
-      emitBytes(OpCode::OP_INVOKE, name);
+      lastCallOffset = currentChunk().code.size();
+      emitNamed(OpCode::OP_INVOKE, name);
       emitByte(argCount);
+      emitInlineCache();
     } else {
-      emitBytes(OpCode::OP_GET_PROPERTY, name);
+      emitNamed(OpCode::OP_GET_PROPERTY, name);
+      emitInlineCache();
+    }
+  }
+  static std::optional<OpCodeType> findIntrinsic(std::string_view name) {
+    for (OpCodeType id = 0; id < INTRINSIC_TOTAL; id++) {
+      if (INTRINSICS[id].name == name) return id;
     }
+    return std::nullopt;
   }
+  /**
+   * A global read right before the arguments is the callee, if it names an intrinsic (and no local shadows it), -
+   * the call becomes "OP_INTRINSIC", which still checks at runtime that the global holds the native.
+  */
   void call(bool) {
+    const auto calleeIsGlobal = lastGlobalReadOffset != SIZE_MAX && lastGlobalReadOffset + 3 == currentChunk().code.size();
+    const auto intrinsic = calleeIsGlobal ? lastGlobalReadIntrinsic : std::nullopt;
     auto argCount = argumentList();
+    if (intrinsic.has_value() && INTRINSICS[intrinsic.value()].arity == argCount) {
+      emitBytes(OpCode::OP_INTRINSIC, intrinsic.value());
+      return;
+    }
+    lastCallOffset = currentChunk().code.size();
     emitBytes(OpCode::OP_CALL, argCount);
+    emitCallCache();
   }
   void expression(void) {
     parsePrecedence(Precedence::PREC_ASSIGNMENT);  // Start with a relatively lower precedence.
@@ -489,10 +860,36 @@ struct Compiler {
   void endScope(void) {
     scopeDepth--;
     while (localCount > 0 && locals[localCount - 1].depth > scopeDepth) {
-      // Closed locals will be hoisted onto the heap.
-      emitByte(locals[localCount - 1].isCaptured ? OpCode::OP_CLOSE_UPVALUE : OpCode::OP_POP);
-      localCount--;
+      // Closed locals will be hoisted onto the heap, the ones copied into the closures are simply gone.
+      auto& local = locals[localCount - 1];
+      emitByte(local.isCaptured && !captureByValue(local) ? OpCode::OP_CLOSE_UPVALUE : OpCode::OP_POP);
+      removeLocal();
+    }
+  }
+  /**
+   * Once the scope of a captured local ends, all the code which could assign it has been compiled. -
+   * If none does, the closures get a copy of its value instead of sharing it through an "ObjUpvalue": -
+   * the captures of this function are patched into "CAPTURE_LOCAL_VALUE", -
+   * and the reads of the upvalue in the closures into "OP_GET_CAPTURED" (their code keeps its size). -
+   * Return whether the local is captured by value.
+  */
+  bool captureByValue(Local& local) {
+    if (local.reassigned || Error::hadError) return false;  // The code of a broken program may not be well-formed.
+    for (const auto offset : local.captureOperands) {
+      auto& kind = currentChunk().code[offset];
+      kind = CAPTURE_LOCAL_VALUE | (kind & CAPTURE_WIDE);
+    }
+    for (const auto& [function, index] : local.upvalues) {
+      auto& code = function->chunk.code;
+      for (size_t offset = 0; offset < code.size(); offset += function->chunk.instructionSize(offset)) {
+        if (code[offset] == OpCode::OP_GET_UPVALUE && code[offset + 1] == index) {
+          code[offset] = OpCode::OP_GET_CAPTURED;
+        } else if (code[offset] == OpCode::OP_WIDE && code[offset + 1] == OpCode::OP_GET_UPVALUE && (code[offset + 2] << 8 | code[offset + 3]) == index) {
+          code[offset + 1] = OpCode::OP_GET_CAPTURED;
+        }
+      }
     }
+    return true;
   }
   auto emitJump(OpCodeType instruction) {
     emitByte(instruction);
@@ -500,11 +897,21 @@ struct Compiler {
     emitByte(0xff);
     return static_cast<size_t>(currentChunk().count() - 2);  // Return the position to the placeholder.
   }
+  /**
+   * Record a jump whose offset doesn't fit in its 16-bit operand, -
+   * "ChunkOptimizer::relaxJumps" turns it into a long form once the function is compiled.
+  */
+  void farJump(size_t instruction, size_t target) {
+    currentChunk().farJumps[instruction] = target;
+  }
   void emitLoop(size_t loopStart) {
     // Unconditionally jumps backwards by a given offset.
     emitByte(OpCode::OP_LOOP);
     auto offset = currentChunk().count() - loopStart + 2;
-    if (offset > UINT16_MAX) errorAtCurrent("loop body too large.");
+    if (offset > UINT16_MAX) {
+      farJump(currentChunk().count() - 1, loopStart);
+      offset = 0;
+    }
     emitByte((offset >> 8) & 0xff);
     emitByte(offset & 0xff);
   }
@@ -512,7 +919,8 @@ struct Compiler {
     // -2 to adjust for the bytecode for the jump offset itself.
     auto jump = currentChunk().count() - offset - 2; 
     if (jump > UINT16_MAX) {
-      errorAtCurrent("too much code to jump over.");
+      farJump(offset - 1, currentChunk().count());
+      jump = 0;
     }
     currentChunk().code[offset] = (jump >> 8) & 0xff;  // Higer 8-bits offset.
     currentChunk().code[offset + 1] = jump & 0xff;  // Lower 8-bits offset.
@@ -530,19 +938,45 @@ struct Compiler {
     if (match(TokenType::ELSE)) statement();
     patchJump(elseJump);
   }
+  /**
+   * A constant left operand of "and" / "or" either is the result (then the right operand is folded away, if it's a constant), -
+   * or isn't (then it's dropped along with the jumps, the right operand is the result).
+  */
   void or_(bool) {
+    const auto leftStart = leftOperandStart;
+    const auto left = loadedConstant(leftStart, currentChunk().code.size());
+    if (left.has_value() && isFalsey(left.value())) {
+      discardConstantLoads(leftStart);
+      parsePrecedence(Precedence::PREC_OR);
+      return;
+    }
     auto elseJump = emitJump(OpCode::OP_JUMP_IF_FALSE);
     auto endJump = emitJump(OpCode::OP_JUMP);
     patchJump(elseJump);
     emitByte(OpCode::OP_POP);
+    const auto rightStart = currentChunk().code.size();
     parsePrecedence(Precedence::PREC_OR);
     patchJump(endJump);
+    if (left.has_value() && loadedConstant(rightStart, currentChunk().code.size()).has_value()) {
+      replaceWithConstant(leftStart, left.value());
+    }
   }
   void and_(bool) {
+    const auto leftStart = leftOperandStart;
+    const auto left = loadedConstant(leftStart, currentChunk().code.size());
+    if (left.has_value() && !isFalsey(left.value())) {
+      discardConstantLoads(leftStart);
+      parsePrecedence(Precedence::PREC_AND);
+      return;
+    }
     auto endJump = emitJump(OpCode::OP_JUMP_IF_FALSE);
     emitByte(OpCode::OP_POP);
+    const auto rightStart = currentChunk().code.size();
     parsePrecedence(Precedence::PREC_AND);  // Parse infix "and" with its right operand.
     patchJump(endJump);
+    if (left.has_value() && loadedConstant(rightStart, currentChunk().code.size()).has_value()) {
+      replaceWithConstant(leftStart, left.value());
+    }
   }
   void whileStatement(void) {
     auto loopStart = currentChunk().count();
@@ -556,6 +990,132 @@ struct Compiler {
     patchJump(exitJump);
     emitByte(OpCode::OP_POP);
   }
+  VMValue caseLabel(void) {
+    if (match(TokenType::MINUS)) {
+      consume(TokenType::NUMBER, "expect a literal after 'case'.");
+      return VMValue::number(-std::get<typeRuntimeNumericValue>(previous().literal));
+    }
+    if (match(TokenType::NUMBER)) return VMValue::number(std::get<typeRuntimeNumericValue>(previous().literal));
+    if (match(TokenType::STRING)) return internedConstants->add(std::get<std::string_view>(previous().literal));
+    if (match(TokenType::TRUE)) return true;
+    if (match(TokenType::FALSE)) return false;
+    if (match(TokenType::NIL)) return std::monostate {};
+    errorAtCurrent("expect a literal after 'case'.");
+    return std::monostate {};
+  }
+  /**
+   * The value is popped by a single instruction, which jumps to the body of the matching case, -
+   * to the default case, or past the statement (see "SwitchTable"). Labels in a row share the body which follows them, -
+   * each body is a scope, ending with a jump past the statement.
+   * The table is hashed, unless the labels are integers dense enough for indexing an array by the value.
+   *
+   *   value; SWITCH_HASH | SWITCH_TABLE table; body 1; JUMP end; body 2; JUMP end; ... body N; end:
+  */
+  void switchStatement(void) {
+    consume(TokenType::LEFT_PAREN, "expect '(' after 'switch'.");
+    expression();
+    consume(TokenType::RIGHT_PAREN, "expect ')' after switch value.");
+    consume(TokenType::LEFT_BRACE, "expect '{' before switch cases.");
+    const auto switchOffset = currentChunk().count();
+    const auto tableIdx = currentChunk().addSwitchTable();
+    if (tableIdx > UINT16_MAX) {
+      errorAtPrevious("too many switch statements in one chunk.");
+    }
+    emitByte(OpCode::OP_SWITCH_HASH);
+    emitShort(tableIdx);
+    std::vector<size_t> endJumps;
+    auto hasDefault = false;
+    while (!check(TokenType::RIGHT_BRACE) && !check(TokenType::SOURCE_EOF)) {
+      auto& table = currentChunk().switchTables[tableIdx];  // Not kept across the bodies, a nested "switch" adds a table.
+      if (match(TokenType::CASE)) {
+        const auto label = caseLabel();
+        if (!table.cases.emplace(SwitchTable::key(label).bits, currentChunk().count()).second) {
+          errorAtPrevious("duplicate case label.");
+        }
+        table.labels.push_back(label);
+      } else {
+        consume(TokenType::DEFAULT, "expect 'case' or 'default'.");
+        if (hasDefault) errorAtPrevious("duplicate default case.");
+        hasDefault = true;
+        table.defaultTarget = currentChunk().count();
+      }
+      consume(TokenType::COLON, "expect ':' after case label.");
+      if (check(TokenType::CASE) || check(TokenType::DEFAULT)) continue;  // Labels in a row share the body.
+      beginScope();
+      while (!check(TokenType::CASE) && !check(TokenType::DEFAULT) && !check(TokenType::RIGHT_BRACE) && !check(TokenType::SOURCE_EOF)) {
+        declaration();
+      }
+      endScope();
+      endJumps.push_back(emitJump(OpCode::OP_JUMP));
+    }
+    consume(TokenType::RIGHT_BRACE, "expect '}' after switch cases.");
+    if (!endJumps.empty()) {
+      currentChunk().truncate(endJumps.back() - 1);  // The last body simply falls through past the statement.
+      endJumps.pop_back();
+    }
+    for (const auto jump : endJumps) {
+      patchJump(jump);
+    }
+    auto& table = currentChunk().switchTables[tableIdx];
+    if (!hasDefault) table.defaultTarget = currentChunk().count();
+    const auto isInteger = [](const VMValue& label) { return SwitchTable::key(label).isInt(); };
+    if (table.labels.empty() || !std::ranges::all_of(table.labels, isInteger)) return;
+    const auto [low, high] = std::ranges::minmax(table.labels | std::views::transform([](const VMValue& label) {
+      return static_cast<int64_t>(SwitchTable::key(label).asInt());
+    }));
+    const auto span = static_cast<size_t>(high - low + 1);
+    if (span > SWITCH_TABLE_DENSITY * table.labels.size()) return;
+    table.low = static_cast<int32_t>(low);
+    table.targets.assign(span, table.defaultTarget);
+    for (const auto& label : table.labels) {
+      table.targets[SwitchTable::key(label).asInt() - low] = table.hashedTarget(label);
+    }
+    table.cases.clear();
+    currentChunk().code[switchOffset] = OpCode::OP_SWITCH_TABLE;
+  }
+  /**
+   * Match the clauses of a counted loop, "for (...; i < limit; i = i + step)" (or "i > limit" / "i = i - step"), -
+   * where "i" is a local, "limit" is a local or a constant, and "step" is a number constant. -
+   * "condition" and "increment" are where the code of the clauses starts, the increment being the last code emitted.
+   * Return the instruction which runs both clauses at the end of each iteration, with its operands.
+  */
+  std::optional<std::array<OpCodeType, 4>> countedLoop(size_t condition, size_t increment) {
+    auto& chunk = currentChunk();
+    const auto& code = chunk.code;
+    if (increment - condition != 5 + 4 + 3) return std::nullopt;  // Condition, "JUMP_IF_FALSE; POP", "JUMP".
+    const auto counter = code[condition + 1];
+    const auto limit = code[condition + 3];
+    if (code[condition] != OpCode::OP_GET_LOCAL ||
+      (code[condition + 2] != OpCode::OP_GET_LOCAL && code[condition + 2] != OpCode::OP_CONSTANT) ||
+      (code[condition + 4] != OpCode::OP_LESS && code[condition + 4] != OpCode::OP_GREATER)) return std::nullopt;
+    // The increment is either "i = i + k" (GET_LOCAL; CONSTANT; ADD | SUBTRACT; SET_LOCAL), or "i += k" / "i++" / "++i" (CONSTANT; COMPOUND_LOCAL).
+    OpCodeType step, arithmetic;
+    if (code.size() - increment == 7 &&
+      code[increment] == OpCode::OP_GET_LOCAL &&
+      code[increment + 1] == counter &&
+      code[increment + 2] == OpCode::OP_CONSTANT &&
+      code[increment + 5] == OpCode::OP_SET_LOCAL &&
+      code[increment + 6] == counter) {
+      step = code[increment + 3];
+      arithmetic = code[increment + 4];
+    } else if (code.size() - increment == 5 &&
+      code[increment] == OpCode::OP_CONSTANT &&
+      code[increment + 2] == OpCode::OP_COMPOUND_LOCAL &&
+      code[increment + 3] == counter) {
+      step = code[increment + 1];
+      arithmetic = code[increment + 4] & ~COMPOUND_POSTFIX;  // The value of the increment clause is discarded.
+    } else {
+      return std::nullopt;
+    }
+    if ((arithmetic != OpCode::OP_ADD && arithmetic != OpCode::OP_SUBTRACT) || !chunk.constants[step].isNumber()) return std::nullopt;
+    if (arithmetic == OpCode::OP_SUBTRACT && shortConstants == UINT8_COUNT) return std::nullopt;  // No room for the negated step.
+    if (arithmetic == OpCode::OP_SUBTRACT) step = static_cast<OpCodeType>(makeConstant(numberNegate(chunk.constants[step])));
+    const auto isLess = code[condition + 4] == OpCode::OP_LESS;
+    const OpCodeType op = code[condition + 2] == OpCode::OP_GET_LOCAL ?
+      (isLess ? OpCode::OP_FOR_LOOP_LESS_RR : OpCode::OP_FOR_LOOP_GREATER_RR) :
+      (isLess ? OpCode::OP_FOR_LOOP_LESS_RK : OpCode::OP_FOR_LOOP_GREATER_RK);
+    return std::array<OpCodeType, 4> { op, counter, limit, step };
+  }
   void forStatement(void) {
     beginScope();
     consume(TokenType::LEFT_PAREN, "expect '(' after 'for'.");
@@ -565,7 +1125,9 @@ struct Compiler {
       expressionStatement();
     }
     auto loopStart = currentChunk().count();
+    const auto conditionStart = loopStart;
     std::optional<size_t> exitJump;
+    std::optional<std::array<OpCodeType, 4>> counted;
     if (!match(TokenType::SEMICOLON)) {  // Condition clause.
       expression();
       consume(TokenType::SEMICOLON, "expect ';' after loop condition.");
@@ -577,20 +1139,51 @@ struct Compiler {
       auto bodyJump = emitJump(OpCode::OP_JUMP);
       auto incrementStart = currentChunk().count();
       expression();
-      emitByte(OpCode::OP_POP);
-      consume(TokenType::RIGHT_PAREN, "expect ')' after for clauses.");
-      emitLoop(loopStart);
-      loopStart = incrementStart;
-      patchJump(bodyJump);
+      if (exitJump.has_value()) counted = countedLoop(conditionStart, incrementStart);
+      if (counted.has_value()) {
+        // The condition is checked once before the first iteration, then the fused instruction does both clauses.
+        currentChunk().truncate(bodyJump - 1);
+        consume(TokenType::RIGHT_PAREN, "expect ')' after for clauses.");
+      } else {
+        emitByte(OpCode::OP_POP);
+        consume(TokenType::RIGHT_PAREN, "expect ')' after for clauses.");
+        emitLoop(loopStart);
+        loopStart = incrementStart;
+        patchJump(bodyJump);
+      }
     }
+    const auto bodyStart = currentChunk().count();
     statement();
-    emitLoop(loopStart);
-    if (exitJump.has_value()) {
+    if (counted.has_value()) {
+      for (const auto byte : counted.value()) emitByte(byte);
+      auto offset = currentChunk().count() - bodyStart + 2;
+      if (offset > UINT16_MAX) {
+        farJump(currentChunk().count() - counted.value().size(), bodyStart);
+        offset = 0;
+      }
+      emitBytes((offset >> 8) & 0xff, offset & 0xff);
+      // Falling through leaves no condition on the stack, skip the "POP" of the first check.
+      const auto endJump = emitJump(OpCode::OP_JUMP);
       patchJump(exitJump.value());
       emitByte(OpCode::OP_POP);
+      patchJump(endJump);
+    } else {
+      emitLoop(loopStart);
+      if (exitJump.has_value()) {
+        patchJump(exitJump.value());
+        emitByte(OpCode::OP_POP);
+      }
     }
     endScope();
   }
+  static std::optional<OpCodeType> tailCallOf(OpCodeType op) {
+    switch (op) {
+      case OpCode::OP_CALL: return OpCode::OP_TAIL_CALL;
+      case OpCode::OP_INVOKE: return OpCode::OP_TAIL_INVOKE;
+      case OpCode::OP_SUPER_INVOKE: return OpCode::OP_TAIL_SUPER_INVOKE;
+      default: return std::nullopt;
+    }
+  }
   void returnStatement(void) {
     if (compilingScope == FunctionScope::TYPE_TOP_LEVEL) {
       errorAtPrevious("can't return from top-level code.");
@@ -603,6 +1196,15 @@ struct Compiler {
       }
       expression();
       consume(TokenType::SEMICOLON, "expect ';' after return value.");
+      auto& chunk = currentChunk();
+      const auto wide = lastCallOffset < chunk.code.size() && chunk.code[lastCallOffset] == OpCode::OP_WIDE;
+      const auto callOp = lastCallOffset + (wide ? 1 : 0);  // An "OP_INVOKE" with a wide name keeps its prefix.
+      const auto tailCall = callOp < chunk.code.size() ? tailCallOf(chunk.code[callOp]) : std::nullopt;
+      if (tailCall.has_value() && lastCallOffset + chunk.instructionSize(lastCallOffset) == chunk.code.size()) {
+        // The call is the last thing the returned expression does, "OP_RETURN" stays for the callees which -
+        // don't take over the frame (natives, classes without an initializer), and for the jumps of "and" / "or".
+        chunk.code[callOp] = tailCall.value();
+      }
       emitByte(OpCode::OP_RETURN);
     }
   }
@@ -615,6 +1217,8 @@ struct Compiler {
       forStatement();
     } else if (match(TokenType::WHILE)) {
       whileStatement();
+    } else if (match(TokenType::SWITCH)) {
+      switchStatement();
     } else if (match(TokenType::LEFT_BRACE)) {
       beginScope();
       block();
@@ -633,6 +1237,29 @@ struct Compiler {
     consume(TokenType::SEMICOLON, "expect ';' after variable declaration.");
     defineVariable(varConstantIdx);
   }
+  /**
+   * A constant is defined like a variable, and can't be assigned afterwards. -
+   * When its initializer folds into a single constant load, the reads of the constant load the value instead.
+  */
+  void constDeclaration(void) {
+    const auto globalSlot = parseVariable("expect constant name.");
+    consume(TokenType::EQUAL, "expect '=' after constant name.");
+    const auto start = currentChunk().code.size();
+    expression();
+    consume(TokenType::SEMICOLON, "expect ';' after constant declaration.");
+    const auto value = loadedConstant(start, currentChunk().code.size());
+    if (globalSlot.has_value()) {
+      const auto assignment = globalSlots->assignments.find(globalSlot.value());
+      if (assignment != globalSlots->assignments.end()) {
+        throw TokenError { *assignment->second, "can't assign to a constant." };  // Compiled before the declaration.
+      }
+      globalSlots->constants[globalSlot.value()] = value;
+    } else {
+      locals[localCount - 1].isConst = true;
+      locals[localCount - 1].value = value;
+    }
+    defineVariable(globalSlot);
+  }
   auto functionCore(void) {
     beginScope();
     consume(TokenType::LEFT_PAREN, "expect '(' after function name.");
@@ -655,13 +1282,20 @@ struct Compiler {
     const auto compiledFunc = compiler.functionCore();
     current = compiler.current;  // Update compiling function.
     if (compiledFunc->upvalueCount > 0) {
-      emitBytes(OpCode::OP_CLOSURE, makeConstant(compiledFunc));
+      emitNamed(OpCode::OP_CLOSURE, makeConstant(compiledFunc));
       for (uint32_t i = 0; i < compiledFunc->upvalueCount; i++) {
-        emitByte(compiler.upvalues[i].isLocal ? 1 : 0);  // local or upvalue.
-        emitByte(compiler.upvalues[i].index);  // local slot or upvalue index.
+        const auto& upvalue = compiler.upvalues[i];
+        const OpCodeType wide = upvalue.index > UINT8_MAX ? CAPTURE_WIDE : 0;
+        if (upvalue.isLocal) locals[upvalue.index].captureOperands.push_back(currentChunk().count());
+        emitByte((upvalue.isLocal ? CAPTURE_LOCAL : CAPTURE_UPVALUE) | wide);  // Until the scope of the local ends (see "captureByValue").
+        if (wide) {
+          emitShort(upvalue.index);  // local slot or upvalue index.
+        } else {
+          emitByte(upvalue.index);
+        }
       }
     } else {
-      emitBytes(OpCode::OP_CONSTANT, makeConstant(compiledFunc));
+      emitConstant(compiledFunc);
     }
   }
   void funDeclaration(void) {
@@ -672,13 +1306,14 @@ struct Compiler {
   }
   void method(void) {
     consume(TokenType::IDENTIFIER, "expect method name.");
+    internedConstants->assignSelector(internedConstants->add(previous().lexeme));
     const auto constant = identifierConstant(previous());
     auto scope = FunctionScope::TYPE_METHOD;
     if (previous().lexeme == INITIALIZER_NAME) {
       scope = FunctionScope::TYPE_INITIALIZER;
     }
     function(scope);
-    emitBytes(OpCode::OP_METHOD, constant);
+    emitNamed(OpCode::OP_METHOD, constant);
   }
   void super_(bool) {
     if (currentClass == nullptr) {
@@ -694,11 +1329,13 @@ struct Compiler {
     if (match(TokenType::LEFT_PAREN)) {  // Combind the "OP_GET_SUPER" and "OP_CALL".
       const auto argCount = argumentList();
       namedVariable(syntheticTokens.find("super")->second, false);
-      emitBytes(OpCode::OP_SUPER_INVOKE, name);
+      lastCallOffset = currentChunk().code.size();
+      emitNamed(OpCode::OP_SUPER_INVOKE, name);
       emitByte(argCount);
+      emitInlineCache();
     } else {
       namedVariable(syntheticTokens.find("super")->second, false);
-      emitBytes(OpCode::OP_GET_SUPER, name);
+      emitNamed(OpCode::OP_GET_SUPER, name);
     }
   }
   void this_(bool) {
@@ -712,8 +1349,9 @@ struct Compiler {
     const auto& className = previous();
     const auto nameConstant = identifierConstant(className);  // Add the name to the surrounding function’s constant table.
     declareVariable();
-    emitBytes(OpCode::OP_CLASS, nameConstant);  // Create runtime representation.
-    defineVariable(nameConstant);  // Mark local or add the runtime entry to the global store.
+    emitNamed(OpCode::OP_CLASS, nameConstant);  // Create runtime representation.
+    // Mark local or store into the global slot.
+    defineVariable(scopeDepth == 0 ? std::make_optional(globalSlot(className)) : std::nullopt);
 
     // Add the compiling class to the class chain.
     ClassCompiler classCompiler;
@@ -757,6 +1395,8 @@ struct Compiler {
         classDeclaration();
       } else if (match(TokenType::VAR)) {
         varDeclaration();
+      } else if (match(TokenType::CONST)) {
+        constDeclaration();
       } else {
         statement();
       }
@@ -770,11 +1410,13 @@ struct Compiler {
       if (previous().type == TokenType::SEMICOLON) return;
       switch (peek().type) {
         case TokenType::CLASS:
+        case TokenType::CONST:
         case TokenType::FN:
         case TokenType::VAR:
         case TokenType::FOR:
         case TokenType::IF:
         case TokenType::WHILE:
+        case TokenType::SWITCH:
         case TokenType::RETURN:
           return;
         default: ;
@@ -783,7 +1425,20 @@ struct Compiler {
     }
   }
   ObjFunc* endCompiler(void) {
+    for (size_t i = 0; i < localCount; i++) {  // The locals of the outermost scope end with the function.
+      if (locals[i].isCaptured) captureByValue(locals[i]);
+    }
     emitReturn();
+    if (!Error::hadError) {  // The code of a broken program may not be well-formed.
+      if (!currentChunk().farJumps.empty()) ChunkOptimizer::relaxJumps(currentChunk());
+      if (registerMode) ChunkOptimizer::lowerToRegisters(currentChunk());
+      ChunkOptimizer::fuseSuperinstructions(currentChunk());
+      try {
+        ChunkVerifier::verify(compilingFunc, globalSlots->values.size());
+      } catch (const VMError& err) {
+        Error::error(err.line, err.what());
+      }
+    }
 #ifdef DEBUG_PRINT_CODE
     ChunkDebugger::disassembleChunk(currentChunk(), compilingFunc->name != nullptr ? compilingFunc->name->str.data() : "<script>");
 #endif 
@@ -794,7 +1449,9 @@ struct Compiler {
     while (!match(TokenType::SOURCE_EOF)) {
       declaration();
     }
-    return endCompiler();
+    const auto function = endCompiler();
+    mem->setCompiler(nullptr);  // The compiler doesn't outlive the compilation, its roots are reachable from the VM then.
+    return function;
   }
 };
 
@@ -2,18 +2,22 @@
 #define	_CONSTANT_H
 
 /**
- * Constant pool (mainly for interned strings).
+ * Constant pool (mainly for interned strings), and the slot table of global variables.
 */
 
 #include <string_view>
 #include <unordered_map>
+#include <optional>
+#include <vector>
 #include "./object.h"
 #include "./memory.h"
+#include "./token.h"
 
 struct Obj;
 struct InternedConstants  {
   Memory* mem;
   std::unordered_map<std::string_view, Obj*> table;
+  uint32_t selectorCount = 0;
   explicit InternedConstants(Memory* memPtr) : mem(memPtr) {};
   Obj* add(std::string_view str) {
     const auto target = table.find(str);
@@ -21,10 +25,44 @@ struct InternedConstants  {
       return target->second;  // Reuse the existing interned string obj.
     } else {
       const auto heapStr = mem->makeObj<ObjString>(str);
-      table[str] = heapStr;
+      table[heapStr->str] = heapStr;  // Key by the string owned by the heap object, "str" may not outlive this call.
       return heapStr;  // Generate a new sting obj on the heap.
     }
   };
+  /**
+   * Give a method name the next global selector number, the methods of a class are indexed by them. -
+   * A name stays interned as long as a method has it, so its selector never changes.
+  */
+  void assignSelector(Obj* name) {
+    auto str = name->cast<ObjString>();
+    if (str->selector == ObjString::NO_SELECTOR) {
+      str->selector = selectorCount++;
+    }
+  }
+};
+
+/**
+ * The compiler resolves each global name into a fixed slot of "values", -
+ * so the byte code addresses a global directly instead of hashing its name at runtime.
+ * A slot holds the "undefined" sentinel until its "OP_DEFINE_GLOBAL" (or "VM::defineNative") runs.
+*/
+struct GlobalSlots {
+  std::unordered_map<Obj*, size_t> slots;  // Interned name -> slot.
+  std::vector<Obj*> names;  // Slot -> interned name, for reporting undefined variables.
+  std::vector<VMValue> values;
+  std::unordered_map<size_t, std::optional<VMValue>> constants;  // Slot -> the folded value of a "const" global, if it has one.
+  std::unordered_map<size_t, const Token*> assignments;  // Slot -> the first assignment compiled, a later "const" can't claim the slot.
+  size_t resolve(Obj* name) {
+    const auto target = slots.find(name);
+    if (target != slots.end()) {
+      return target->second;
+    }
+    const auto slot = values.size();
+    slots[name] = slot;
+    names.push_back(name);
+    values.push_back(VMValue::undefined());
+    return slot;
+  }
 };
 
 #endif
@@ -27,6 +27,16 @@ struct TokenError : public std::exception {
   }
 };
 
+// Thrown by a native function on bad arguments, the caller reports it at the call (see "VM::callValue").
+struct NativeError : public std::exception {
+  const std::string msg;
+ public:
+  explicit NativeError(const std::string& msg) : msg(msg) {}
+  const char* what(void) const noexcept {
+    return msg.data();
+  }
+};
+
 struct Error {
   static bool hadError;
   static bool hadTokenError;
@@ -15,6 +15,8 @@ struct LiteralExpr;
 struct GroupingExpr;
 struct AssignExpr;
 struct CallExpr;
+struct CompoundAssignExpr;
+struct CompoundSetExpr;
 struct GetExpr;
 struct LogicalExpr;
 struct SetExpr;
@@ -27,6 +29,8 @@ struct ExprVisitor {
   virtual typeRuntimeValue visitAssignExpr(std::shared_ptr<const AssignExpr>) = 0;
   virtual typeRuntimeValue visitBinaryExpr(std::shared_ptr<const BinaryExpr>) = 0;
   virtual typeRuntimeValue visitCallExpr(std::shared_ptr<const CallExpr>) = 0;
+  virtual typeRuntimeValue visitCompoundAssignExpr(std::shared_ptr<const CompoundAssignExpr>) = 0;
+  virtual typeRuntimeValue visitCompoundSetExpr(std::shared_ptr<const CompoundSetExpr>) = 0;
   virtual typeRuntimeValue visitGetExpr(std::shared_ptr<const GetExpr>) = 0;
   virtual typeRuntimeValue visitGroupingExpr(std::shared_ptr<const GroupingExpr>) = 0;
   virtual typeRuntimeValue visitLiteralExpr(std::shared_ptr<const LiteralExpr>) = 0;
@@ -55,6 +59,21 @@ struct AssignExpr : public Expr, public std::enable_shared_from_this<AssignExpr>
   }
 };
 
+/**
+ * "+=" / "-=", and the postfix "++" / "--" (whose value is a literal one) which evaluate to the old value.
+*/
+struct CompoundAssignExpr : public Expr, public std::enable_shared_from_this<CompoundAssignExpr> {
+  const Token& name;
+  const Token& op;
+  const sharedExprPtr value;
+  const bool isPrefix;  // A prefix "++" / "--".
+  CompoundAssignExpr(const Token& name, const Token& op, sharedExprPtr value, bool isPrefix = false) :
+    name(name), op(op), value(value), isPrefix(isPrefix) {}
+  typeRuntimeValue accept(ExprVisitor* visitor) override {
+    return visitor->visitCompoundAssignExpr(shared_from_this());
+  }
+};
+
 struct CallExpr : public Expr, public std::enable_shared_from_this<CallExpr> {
   const sharedExprPtr callee;  // Could be a "CallExpr" as well.
   const Token& paren;  // Record the location of the closing parenthesis.
@@ -138,6 +157,19 @@ struct SetExpr : public Expr, public std::enable_shared_from_this<SetExpr> {
   }
 };
 
+struct CompoundSetExpr : public Expr, public std::enable_shared_from_this<CompoundSetExpr> {
+  const sharedExprPtr obj; 
+  const Token& name;
+  const Token& op;
+  const sharedExprPtr value; 
+  const bool isPrefix;
+  CompoundSetExpr(sharedExprPtr obj, const Token& name, const Token& op, sharedExprPtr value, bool isPrefix = false) :
+    obj(obj), name(name), op(op), value(value), isPrefix(isPrefix) {}
+  typeRuntimeValue accept(ExprVisitor* visitor) override {
+    return visitor->visitCompoundSetExpr(shared_from_this());
+  }
+};
+
 struct ThisExpr : public Expr, public std::enable_shared_from_this<ThisExpr> {
   const Token& keyword; 
   explicit ThisExpr(const Token& keyword) : keyword(keyword) {}
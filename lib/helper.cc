@@ -2,8 +2,37 @@
 #include <sstream>
 #include "./helper.h"
  
-bool isObjStringValue(const typeRuntimeValue& rt) {
-  return std::holds_alternative<Obj*>(rt) && std::get<Obj*>(rt)->type == ObjType::OBJ_STRING;
+bool isObjStringValue(const VMValue& v) {
+  return isObjType(v, ObjType::OBJ_STRING);
+}
+
+std::string intrinsicTypeError(OpCodeType id) {
+  const auto name = "'" + std::string { INTRINSICS[id].name } + "'";
+  switch (id) {
+    case INTRINSIC_LEN: return "argument of " + name + " must be a string.";
+    case INTRINSIC_CHAR_CODE: return "arguments of " + name + " must be a string and a number.";
+    default: return (INTRINSICS[id].arity == 1 ? "argument of " + name + " must be a number." : "arguments of " + name + " must be numbers.");
+  }
+}
+
+std::string stringifyNumericValue(const typeRuntimeNumericValue num) {
+  if (std::trunc(num) == num && std::abs(num) < 0x1p53 && !(num == 0 && std::signbit(num))) {
+    return std::to_string(static_cast<int64_t>(num));  // Integral, no formatting through the stream is needed.
+  }
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(9) << num;
+  const auto& str = oss.str();
+  const auto& strWithoutZero = str.substr(0, str.find_last_not_of('0') + 1);
+  return strWithoutZero.back() == '.' ? str.substr(0, strWithoutZero.size() - 1) : strWithoutZero;
+}
+
+std::string stringifyVMValue(const VMValue& v) {
+  if (v.isInt()) return std::to_string(v.asInt());
+  if (v.isNumber()) return stringifyNumericValue(v.asNumber());
+  if (v.isBool()) return v.asBool() ? "true" : "false";
+  if (v.isObj()) return v.asObj()->toString();
+  if (v.isStackBound()) return "<bound method>";  // Only seen by the execution trace, see "VM::materialize".
+  return "nil";
 }
 
 /**
@@ -23,6 +23,9 @@ auto enumAsInteger(Enumeration const value) -> typename std::underlying_type<Enu
   return static_cast<typename std::underlying_type<Enumeration>::type>(value);
 }
 
+std::string stringifyNumericValue(const typeRuntimeNumericValue);
+std::string stringifyVMValue(const VMValue&);
+
 template<typename T>
 std::string stringifyVariantValue(const T& literal) {
   static_assert(isVariantV<T>);
@@ -30,11 +33,7 @@ std::string stringifyVariantValue(const T& literal) {
   return std::visit([&](auto&& arg) {
     using K = std::decay_t<decltype(arg)>;
     if constexpr (std::is_same_v<K, typeRuntimeNumericValue>) {
-      std::ostringstream oss;
-      oss << std::fixed << std::setprecision(9) << arg;
-      const auto& str = oss.str();
-      const auto& strWithoutZero = oss.str().substr(0, str.find_last_not_of('0') + 1);
-      return strWithoutZero.back() == '.' ? str.substr(0, strWithoutZero.size() - 1) : strWithoutZero;
+      return stringifyNumericValue(arg);
     } else if constexpr (std::is_same_v<K, bool>) {
       return std::string { arg ? "true" : "false" };
     } else if constexpr (std::is_same_v<K, std::monostate>) {
@@ -43,8 +42,6 @@ std::string stringifyVariantValue(const T& literal) {
       return arg;
     } else if constexpr (std::is_same_v<K, std::string_view>) {
       return std::string { arg };
-    } else if constexpr (std::is_same_v<K, Obj*>) {
-      return arg->toString();
     } else if constexpr (std::is_same_v<K, std::shared_ptr<Invokable>>) {
       return arg->toString();
     } else if constexpr (std::is_same_v<K, std::shared_ptr<ClassInstance>>) {
@@ -70,11 +67,32 @@ inline std::optional<std::string> stringifyValuesOfSpecifiedTypes(const typeRunt
   return std::nullopt;
 } 
 
-inline void printValue(const typeRuntimeValue& v) {
-  std::cout << stringifyVariantValue(v);
+inline void printValue(const VMValue& v) {
+  std::cout << stringifyVMValue(v);
+}
+
+/**
+ * The math natives (see "Intrinsic"), for both the VM and the interpreter, "y" is only read by the binary ones.
+*/
+inline double mathIntrinsic(OpCodeType id, double x, double y) {
+  switch (id) {
+    case INTRINSIC_SQRT: return std::sqrt(x);
+    case INTRINSIC_FLOOR: return std::floor(x);
+    case INTRINSIC_CEIL: return std::ceil(x);
+    case INTRINSIC_ABS: return std::fabs(x);
+    case INTRINSIC_MIN: return y < x ? y : x;
+    case INTRINSIC_MAX: return y > x ? y : x;
+    case INTRINSIC_POW: return std::pow(x, y);
+    case INTRINSIC_SIN: return std::sin(x);
+    case INTRINSIC_COS: return std::cos(x);
+    case INTRINSIC_LOG: return std::log(x);
+    case INTRINSIC_EXP: return std::exp(x);
+    default: return std::nan("");
+  }
 }
 
-bool isObjStringValue(const typeRuntimeValue&);
+bool isObjStringValue(const VMValue&);
+std::string intrinsicTypeError(OpCodeType);
 bool isDoubleEqual(const double, const double);
 std::string unescapeStr(const std::string&);
 
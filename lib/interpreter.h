@@ -77,8 +77,34 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
         return std::monostate {};
       };
     };
+    class InternalFunIntrinsicDef : public Invokable {  // The natives which the VM inlines (see "Intrinsic").
+      const OpCodeType id;
+     public:
+      explicit InternalFunIntrinsicDef(OpCodeType id) : id(id) {}
+      std::string toString(void) override { 
+        return "<fn native>"; 
+      }
+      size_t arity() override { return INTRINSICS[id].arity; };
+      typeRuntimeValue invoke(Interpreter*, std::vector<typeRuntimeValue>& arguments) override {
+        const auto& x = arguments.front();
+        const auto& y = arguments.back();
+        if (id < INTRINSIC_LEN) {
+          if (!isNumericValue(x) || !isNumericValue(y)) throw NativeError { intrinsicTypeError(id) };
+          return mathIntrinsic(id, std::get<typeRuntimeNumericValue>(x), std::get<typeRuntimeNumericValue>(y));
+        }
+        if (!isStringValue(x) || (id == INTRINSIC_CHAR_CODE && !isNumericValue(y))) throw NativeError { intrinsicTypeError(id) };
+        const auto str = stringifyVariantValue(x);
+        if (id == INTRINSIC_LEN) return static_cast<typeRuntimeNumericValue>(str.size());
+        const auto idx = std::get<typeRuntimeNumericValue>(y);
+        if (!(idx >= 0 && idx < str.size()) || std::trunc(idx) != idx) return std::monostate {};
+        return static_cast<typeRuntimeNumericValue>(static_cast<unsigned char>(str[static_cast<size_t>(idx)]));
+      };
+    };
     globals->define("clock", std::make_shared<InternalFunClockDef>());
     globals->define("print", std::make_shared<InternalFunPrintDef>());
+    for (OpCodeType id = 0; id < INTRINSIC_TOTAL; id++) {
+      globals->define(INTRINSICS[id].name, std::make_shared<InternalFunIntrinsicDef>(id));
+    }
   }
   typeRuntimeValue evaluate(Expr::sharedExprPtr expr) {
     return expr->accept(this);
@@ -120,6 +146,10 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
         checkNumberOperand(expr->op, right);
         return -std::get<double>(right);
       }
+      case TokenType::MINUS_MINUS: {  // Negated twice.
+        checkNumberOperand(expr->op, right);
+        return right;
+      }
       case TokenType::BANG: {
         return !isTruthy(right);
       }
@@ -137,6 +167,42 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
     }
     return value;
   }
+  typeRuntimeValue addValues(const Token& op, const typeRuntimeValue& left, const typeRuntimeValue& right) const {
+    /**
+     *  If both sides are double, then return double,
+     *  If either operand is a string, then the final result is string.
+     *  Otherwise, error.
+    */
+    if (isNumericValue(left) && isNumericValue(right)) {
+      return std::get<typeRuntimeNumericValue>(left) + std::get<typeRuntimeNumericValue>(right);
+    } else if (isStringValue(left) || isStringValue(right)) {
+      return stringifyVariantValue(left) + stringifyVariantValue(right);  // String concatenation. 
+    }
+    throw TokenError { op, "invalid operand types for \"+\" operator." };
+  }
+  /**
+   * Apply the operator of a compound assignment, and return the value to be stored.
+  */
+  typeRuntimeValue compoundValue(const Token& op, const typeRuntimeValue& target, const typeRuntimeValue& value) const {
+    if (op.type == TokenType::PLUS_EQUAL || op.type == TokenType::PLUS_PLUS) return addValues(op, target, value);
+    checkNumberOperands(op, target, value);
+    return std::get<typeRuntimeNumericValue>(target) - std::get<typeRuntimeNumericValue>(value);
+  }
+  auto isPostfix(const Token& op) const {
+    return op.type == TokenType::PLUS_PLUS || op.type == TokenType::MINUS_MINUS;  // Evaluates to the old value (unless it's a prefix one).
+  }
+  typeRuntimeValue visitCompoundAssignExpr(std::shared_ptr<const CompoundAssignExpr> expr) override {
+    const auto value = evaluate(expr->value);
+    const auto distance = locals.find(expr);
+    const auto old = lookUpVariable(expr->name, expr);
+    const auto result = compoundValue(expr->op, old, value);
+    if (distance != locals.end()) {
+      env->assignAt(distance->second, expr->name, result);
+    } else {
+      globals->assign(expr->name, result);
+    }
+    return isPostfix(expr->op) && !expr->isPrefix ? old : result;
+  }
   typeRuntimeValue visitVariableExpr(std::shared_ptr<const VariableExpr> expr) override { 
     return lookUpVariable(expr->name, expr);
   }
@@ -180,21 +246,15 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
       case TokenType::LESS_EQUAL: {
         RET_NUM_BINARY_OP(expr->op, <=, left, right)
       }
+      case TokenType::MINUS_MINUS: {  // "a--b", subtracting the negated right operand.
+        checkNumberOperand(expr->op, right);
+        RET_NUM_BINARY_OP(expr->op, +, left, right)
+      }
       case TokenType::MINUS: {
         RET_NUM_BINARY_OP(expr->op, -, left, right)
       } 
       case TokenType::PLUS: {
-        /**
-         *  If both sides are double, then return double,
-         *  If either operand is a string, then the final result is string.
-         *  Otherwise, error.
-        */
-        if (isNumericValue(left) && isNumericValue(right)) {
-          return std::get<typeRuntimeNumericValue>(left) + std::get<typeRuntimeNumericValue>(right);
-        } else if (isStringValue(left) || isStringValue(right)) {
-          return stringifyVariantValue(left) + stringifyVariantValue(right);  // String concatenation. 
-        }
-        throw TokenError { expr->op, "invalid operand types for \"+\" operator." };
+        return addValues(expr->op, left, right);
       }
       case TokenType::SLASH: {
         RET_NUM_BINARY_OP(expr->op, /, left, right)
@@ -225,7 +285,12 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
       throw TokenError { expr->paren, "expected " + std::to_string(function->arity()) + " arguments but got " + std::to_string( arguments.size()) + "." };
     }
     functionCallDepth++;
-    const auto& ret = function->invoke(this, arguments);
+    typeRuntimeValue ret;
+    try {
+      ret = function->invoke(this, arguments);
+    } catch (const NativeError& err) {
+      throw TokenError { expr->paren, err.msg };
+    }
     functionCallDepth--;
     return ret;
   }
@@ -243,6 +308,16 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
     (*vp)->set(expr->name, value);
     return value;
   }
+  typeRuntimeValue visitCompoundSetExpr(std::shared_ptr<const CompoundSetExpr> expr) override {
+    auto obj = evaluate(expr->obj);
+    auto vp = std::get_if<std::shared_ptr<ClassInstance>>(&obj);
+    if (vp == nullptr) throw TokenError { expr->name, "only instances have properties." };
+    const auto value = evaluate(expr->value);
+    const auto old = (*vp)->get(expr->name);
+    const auto result = compoundValue(expr->op, old, value);
+    (*vp)->set(expr->name, result);
+    return isPostfix(expr->op) && !expr->isPrefix ? old : result;
+  }
   typeRuntimeValue visitSuperExpr(std::shared_ptr<const SuperExpr> expr) override {
     const auto distance = locals[expr];
     auto superClass = std::static_pointer_cast<Class>(std::get<std::shared_ptr<Invokable>>(env->getAt(distance, "super")));
@@ -281,6 +356,22 @@ struct Interpreter : public ExprVisitor, public StmtVisitor {
       execute(stmt->body);
     }
   }
+  void visitSwitchStmt(std::shared_ptr<const SwitchStmt> stmt) override {
+    const auto value = evaluate(stmt->value);
+    const auto matches = [&value](const typeRuntimeValue& label) {
+      if (isStringValue(value) && isStringValue(label)) return stringifyVariantValue(value) == stringifyVariantValue(label);
+      return value == label;
+    };
+    const SwitchStmt::Case* matched = nullptr;
+    for (const auto& switchCase : stmt->cases) {
+      if (std::any_of(switchCase.labels.cbegin(), switchCase.labels.cend(), matches)) {
+        matched = &switchCase;
+        break;
+      }
+      if (switchCase.isDefault) matched = &switchCase;  // Unless a label of a later case matches.
+    }
+    if (matched != nullptr) executeBlock(matched->body, std::make_shared<Env>(env));
+  }
   void visitFunctionStmt(std::shared_ptr<const FunctionStmt> stmt) override { 
     std::shared_ptr<Invokable> invoker = std::make_shared<Function>(stmt, env, false);  // Save closure (the definition scope) as well.
     env->define(stmt->name.lexeme, invoker); 
@@ -24,34 +24,27 @@ void Memory::free(bool leaveStr) {  // Freeing non-ObjString objects first.
 
 void Memory::markObject(Obj* obj) {
   if (obj == nullptr || obj->isMarked) return;
-#ifdef DEBUG_LOG_GC
-  printf("-- [%p] marked ", obj);
-  printValue(obj);
-  std::cout << " --" << std::endl;
-#endif
+  if (logGC) [[unlikely]] {
+    printf("-- [%p] marked ", obj);
+    printValue(obj);
+    std::cout << " --" << std::endl;
+  }
   obj->isMarked = true;
   vm->grayStack.push_back(obj);  // Keeping track of all of the gray objects.
 }
 
-void Memory::markValue(typeRuntimeValue& value) {
-  if (std::holds_alternative<Obj*>(value)) {
-    markObject(std::get<Obj*>(value));
+void Memory::markValue(VMValue& value) {
+  if (value.isObj()) {
+    markObject(value.asObj());
+  } else if (value.isStackBound()) {
+    auto& bound = vm->stackBoundMethods[value.asStackBound()];
+    markValue(bound.receiver);
+    markObject(bound.method);
+    markObject(bound.materialized);
   }
 }
 
-template<typename T> 
-void Memory::markTable(typeVMStore<T>& map) {
-  for (auto& [key, value] : map) {
-    markObject(key);
-    if constexpr (std::is_same_v<T, Obj*>) {
-      markObject(value);
-    } else {
-      markValue(value); 
-    }
-  }
-}
-
-void Memory::markArray(typeRuntimeConstantArray& array) {
+void Memory::markArray(typeVMConstantArray& array) {
   for (auto& v : array) {
     markValue(v);
   }
@@ -73,20 +66,32 @@ void Memory::markRoots(void) {
   for (size_t i = 0; i < vm->frameCount; i++) {
     markObject(vm->frames[i].frameEntity);  // Mark "ObjClosure" or "FuncObj".
   }
-  for (Obj* upvalue = vm->openUpvalues; upvalue != nullptr; upvalue = upvalue->next) {
-    markObject(upvalue);
+  for (size_t offset = 0; offset < vm->openUpvalueTop; offset++) {
+    markObject(vm->openUpvalues[offset]);
+  }
+  for (const auto name : vm->globals.names) {
+    markObject(name);
+  }
+  for (auto& value : vm->globals.values) {
+    markValue(value);
+  }
+  for (auto& [slot, folded] : vm->globals.constants) {
+    if (folded.has_value()) markValue(folded.value());  // Its definition may never have run (a failed REPL line).
   }
-  markTable(vm->globals);
   markCompilerRoots(compiler);
   markObject(vm->initString);
+  markObject(vm->rootShape);
+  for (const auto native : vm->intrinsics) {
+    markObject(native);  // Keep them alive after their globals are reassigned, a new object at the same address would pass the guard.
+  }
 }
 
 void Memory::blackenObject(Obj* obj) {
-#ifdef DEBUG_LOG_GC
-  printf("-- [%p] Blacken ", obj);
-  printValue(obj);
-  std::cout << " --" << std::endl;
-#endif
+  if (logGC) [[unlikely]] {
+    printf("-- [%p] Blacken ", obj);
+    printValue(obj);
+    std::cout << " --" << std::endl;
+  }
   // A black object is any object whose isMarked field is set and that is no longer in the gray stack.
   switch (obj->type) {
     case ObjType::OBJ_NATIVE:
@@ -100,26 +105,48 @@ void Memory::blackenObject(Obj* obj) {
       auto function = retrieveObjFunc(obj);
       markObject(function->name);
       markArray(function->chunk.constants);
+      for (const auto& cache : function->chunk.caches) {  // Keep the cached receivers alive, so their addresses can't be reused.
+        for (uint8_t i = 0; i < cache.count; i++) {
+          markObject(cache.entries[i].klass);
+          markObject(cache.entries[i].shape);
+          markObject(cache.entries[i].method);
+        }
+      }
+      for (const auto& cache : function->chunk.callCaches) {
+        markObject(cache.callee);
+      }
+      for (auto& table : function->chunk.switchTables) {
+        markArray(table.labels);  // The string labels are matched by address, they must stay interned.
+      }
       break;
     }
     case ObjType::OBJ_CLOSURE: {
       auto closure = obj->cast<ObjClosure>();
       markObject(closure->function);
-      for (const auto& uvObj : closure->upvalues) {
-        markObject(uvObj);
+      for (uint32_t i = 0; i < closure->upvalueCount; i++) {
+        markValue(closure->upvalues()[i]);
       }
       break;
     }
     case ObjType::OBJ_CLASS: {
       auto klass = obj->cast<ObjClass>();
       markObject(klass->name);
-      markTable(klass->methods);
+      klass->forEachMethod([this](Obj* method) { markObject(method); });
       break;
     }
     case ObjType::OBJ_INSTANCE: {
       auto instance = obj->cast<ObjInstance>();
       markObject(instance->klass);
-      markTable(instance->fields);
+      markObject(instance->shape);
+      for (auto& field : instance->fields) {
+        markValue(field);
+      }
+      break;
+    }
+    case ObjType::OBJ_SHAPE: {
+      auto shape = obj->cast<ObjShape>();
+      markObject(shape->parent);  // The keys of the ancestors are marked along the parent chain.
+      if (!shape->keys.empty()) markObject(shape->keys.back());
       break;
     }
     case ObjType::OBJ_BOUND_METHOD: {
@@ -173,19 +200,33 @@ void Memory::tableRemoveWhite(void) {
   }
 }
 
+void Memory::shapeRemoveWhite(ObjShape* shape) {
+  // Removing the unreached shapes from the transition tree, a reached shape always has its parent reached.
+  if (shape == nullptr) return;
+  for (auto it = shape->transitions.begin(); it != shape->transitions.end();) {
+    if (!it->second->isMarked) {
+      it = shape->transitions.erase(it);
+    } else {
+      shapeRemoveWhite(it->second);
+      it++;
+    }
+  }
+}
+
 void Memory::gc(void) {
-  if (vm == nullptr || compiler == nullptr) return;
-#ifdef DEBUG_LOG_GC
-  std::cout << "\n-- GC BEGIN --" << std::endl;
+  if (vm == nullptr) return;
   const auto before = bytesAllocated;
-#endif
+  if (logGC) [[unlikely]] {
+    std::cout << "\n-- GC BEGIN --" << std::endl;
+  }
   markRoots();
   traceReferences();
   tableRemoveWhite();
+  shapeRemoveWhite(vm->rootShape);
   sweep();
   nextGC = bytesAllocated * GC_HEAP_GROW_FACTOR;
-#ifdef DEBUG_LOG_GC
-  std::cout << "-- GC END --\n" << std::endl;
-  printf("Collected %zu bytes (from %zu to %zu) next at %zu.\n", before - bytesAllocated, before, bytesAllocated, nextGC);
-#endif
+  if (logGC) [[unlikely]] {
+    std::cout << "-- GC END --\n" << std::endl;
+    printf("Collected %zu bytes (from %zu to %zu) next at %zu.\n", before - bytesAllocated, before, bytesAllocated, nextGC);
+  }
 }
@@ -19,13 +19,14 @@ struct Memory {
   Compiler* compiler = nullptr;
   size_t bytesAllocated = 0;
   size_t nextGC = 1024 * 1024;
+  bool logGC = false;  // Print each allocation, mark, free and collection.
   Memory() = default;
   void setVM(VM* vmPtr) { vm = vmPtr; }
   void setCompiler(Compiler* compilerPtr) { compiler = compilerPtr; }
   inline void freeObj(Obj* obj) {
-#ifdef DEBUG_LOG_GC
-    printf("[%p] Free type %s\n", obj, obj->toString().c_str());
-#endif
+    if (logGC) [[unlikely]] {
+      printf("[%p] Free type %s\n", obj, obj->toString().c_str());
+    }
     bytesAllocated -= sizeof(*obj);
     delete obj;
   }
@@ -38,25 +39,30 @@ struct Memory {
       gc();
     }
 #endif
-    const auto& obj = new T { &objs, std::forward<Args>(args)... };
-#ifdef DEBUG_LOG_GC
-    printf("\n-- [%p] Allocate %zu bytes for '", obj, sizeof(T));      
-    std::cout << Obj::printObjNameByType<T>() << "' --\n" << std::endl;
-#endif
+    T* obj;
+    if constexpr (std::is_same_v<T, ObjClosure>) {
+      obj = new (args...) T { &objs, args... };  // Sized for the trailing upvalues.
+    } else {
+      obj = new T { &objs, std::forward<Args>(args)... };
+    }
+    if (logGC) [[unlikely]] {
+      printf("\n-- [%p] Allocate %zu bytes for '", obj, sizeof(T));
+      std::cout << Obj::printObjNameByType<T>() << "' --\n" << std::endl;
+    }
     return obj;
   }
   void markRoots(void);
   void gc(void);
   void free(bool = true);
   void markObject(Obj*);
-  void markValue(typeRuntimeValue&);
-  template<typename T> void markTable(typeVMStore<T>&);
+  void markValue(VMValue&);
   void markCompilerRoots(Compiler*);
-  void markArray(typeRuntimeConstantArray&);
+  void markArray(typeVMConstantArray&);
   void traceReferences(void);
   void blackenObject(Obj*);
   void sweep(void);
   void tableRemoveWhite(void);
+  void shapeRemoveWhite(ObjShape*);
 };
 
 #endif
@@ -4,18 +4,57 @@
 #include <cstdint>
 #include <iostream>
 #include <ctime>
+#include <array>
+#include <utility>
 #include "./type.h"
 #include "./helper.h"
+#include "./error.h"
+#include "./object.h"
 
-typeRuntimeValue nativePrint(uint8_t argCount, typeVMStack::const_iterator args) {
+VMValue nativePrint(uint8_t argCount, typeVMStack::const_iterator args) {
   for (auto i = 0; i < argCount; i++) {
-    std::cout << stringifyVariantValue(*(args + i));
+    std::cout << stringifyVMValue(*(args + i));
   }
   return std::monostate {};
 }
 
-typeRuntimeValue nativeClock(uint8_t, typeVMStack::const_iterator) {
+VMValue nativeClock(uint8_t, typeVMStack::const_iterator) {
   return static_cast<double>(clock()) / CLOCKS_PER_SEC;
 }
 
+/**
+ * The result of the intrinsic "id" on its arguments, or undefined if their types are wrong. -
+ * It's both the body of the natives below and inlined by "OP_INTRINSIC".
+*/
+inline VMValue applyIntrinsic(OpCodeType id, typeVMStack::const_iterator args) {
+  if (id < INTRINSIC_LEN) {
+    const auto& x = args[0];
+    const auto& y = INTRINSICS[id].arity == 2 ? args[1] : x;
+    if (!x.isNumber() || !y.isNumber()) return VMValue::undefined();
+    return VMValue::number(mathIntrinsic(id, x.asNumber(), y.asNumber()));
+  }
+  if (!isObjStringValue(args[0])) return VMValue::undefined();
+  const auto& str = args[0].asObj()->cast<ObjString>()->str;
+  if (id == INTRINSIC_LEN) return VMValue::integer(static_cast<int32_t>(str.size()));
+  if (!args[1].isNumber()) return VMValue::undefined();
+  const auto idx = args[1].asNumber();
+  if (!(idx >= 0 && idx < str.size()) || std::trunc(idx) != idx) return std::monostate {};
+  return VMValue::integer(static_cast<unsigned char>(str[static_cast<size_t>(idx)]));
+}
+
+template <OpCodeType id>
+VMValue nativeIntrinsic(uint8_t, typeVMStack::const_iterator args) {
+  const auto result = applyIntrinsic(id, args);
+  if (result.isUndefined()) throw NativeError { intrinsicTypeError(id) };
+  return result;
+}
+
+template <size_t... ids>
+constexpr auto makeIntrinsicNatives(std::index_sequence<ids...>) {
+  return std::array<ObjNative::typeNativeFn, sizeof...(ids)> { nativeIntrinsic<ids>... };
+}
+
+// The natives behind the intrinsics, for the calls the compiler can't see through (e.g. "var f = sqrt; f(2);").
+constexpr auto INTRINSIC_NATIVES = makeIntrinsicNatives(std::make_index_sequence<INTRINSIC_TOTAL> {});
+
 #endif
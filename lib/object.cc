@@ -2,5 +2,5 @@
 #include "./helper.h"
 
 std::string ObjUpvalue::toString(void) {
-  return stringifyVariantValue(std::holds_alternative<std::monostate>(closed) ? *location : closed);
+  return stringifyVMValue(closed.isNil() ? *location : closed);
 }
@@ -5,6 +5,7 @@
  * Object structure.
 */
 #include <cassert>
+#include <algorithm>
 #include <variant>
 #include <string>
 #include <memory>
@@ -31,7 +32,9 @@ struct Obj {
 };
 
 struct ObjString : public Obj {
+  static constexpr uint32_t NO_SELECTOR = UINT32_MAX;
   std::string str;
+  uint32_t selector = NO_SELECTOR;  // Assigned to method names by the compiler (see "InternedConstants::assignSelector").
   std::string toString(void) override {
     return str;
   }
@@ -45,6 +48,7 @@ struct ObjString : public Obj {
 struct ObjFunc : public Obj {
   uint8_t arity;
   uint32_t upvalueCount;
+  size_t maxStackHeight = 0;  // Counted from slot zero of the frame, set by the verifier (see "verifier.h").
   Chunk chunk;
   ObjString* name;
   std::string toString(void) override {
@@ -57,26 +61,23 @@ struct ObjFunc : public Obj {
 };
 
 struct ObjUpvalue : public Obj {
-  typeRuntimeValue* location;  // Pointing to the value on the stack.
-  typeRuntimeValue closed = std::monostate {};
-  ObjUpvalue* nextValue;
+  VMValue* location;  // Pointing to the value on the stack.
+  VMValue closed = std::monostate {};
   std::string toString(void) override;
-  ObjUpvalue(
-    Obj** next, 
-    typeRuntimeValue* location, 
-    ObjUpvalue* nextValue = nullptr) : 
-    Obj(ObjType::OBJ_UPVALUE, *next), 
-    location(location), 
-    nextValue(nextValue) {
-      *next = this;
-    }
+  ObjUpvalue(Obj** next, VMValue* location) : Obj(ObjType::OBJ_UPVALUE, *next), location(location) {
+    *next = this;
+  }
   ~ObjUpvalue() {}
 }; 
 
-// The wrapper of "ObjFunc" which includes runtime state for the variables the function closes over.
+/**
+ * The wrapper of "ObjFunc" which includes runtime state for the variables the function closes over.
+ * The upvalues are stored right after the object, so a closure takes a single allocation (see "Memory::makeObj"). -
+ * Each one is an "ObjUpvalue", or the value itself when it is captured by value (see "CaptureKind"). -
+ * A function capturing nothing is never wrapped, the compiler loads it as a constant.
+*/
 struct ObjClosure : public Obj {
   ObjFunc* function;
-  std::vector<ObjUpvalue*> upvalues;  // Each closure has an array of upvalues.
   uint32_t upvalueCount;
   std::string toString(void) override {
     return "<fn " + (function->name == nullptr ? "script" : function->name->str) + ">";
@@ -84,15 +85,30 @@ struct ObjClosure : public Obj {
   explicit ObjClosure(Obj** next, ObjFunc* functionObj) : 
     Obj(ObjType::OBJ_CLOSURE, *next), 
     function(functionObj), 
-    upvalues(function->upvalueCount, nullptr), 
     upvalueCount(function->upvalueCount) {
+      std::uninitialized_fill_n(upvalues(), upvalueCount, VMValue {});  // Visible to GC before all the upvalues are captured.
       *next = this;
     }
+  VMValue* upvalues(void) {
+    return reinterpret_cast<VMValue*>(this + 1);
+  }
+  ObjUpvalue* upvalue(size_t idx) {
+    return upvalues()[idx].asObj()->cast<ObjUpvalue>();
+  }
+  static void* operator new(size_t size, ObjFunc* function) {
+    return ::operator new(size + function->upvalueCount * sizeof(VMValue));
+  }
+  static void operator delete(void* ptr) {
+    ::operator delete(ptr);
+  }
+  static void operator delete(void* ptr, ObjFunc*) {
+    ::operator delete(ptr);
+  }
   ~ObjClosure() {}
 };
 
 struct ObjNative : public Obj {
-  using typeNativeFn = typeRuntimeValue (*)(uint8_t, typeVMStack::const_iterator);
+  using typeNativeFn = VMValue (*)(uint8_t, typeVMStack::const_iterator);
   uint8_t arity;
   typeNativeFn function;
   Obj* name;
@@ -113,42 +129,222 @@ struct ObjNative : public Obj {
   ~ObjNative() {}
 };
 
+/**
+ * The method rows of all classes packed into one table, each row is displaced by its base into the entries -
+ * the other rows leave free, so a class only takes the entries of the selectors it has (not the span between them).
+ * "owners" tells which row an entry belongs to, a subclass shares the row of its superclass until it defines a method.
+*/
+struct DispatchTable {
+  static constexpr uint32_t NO_ROW = 0;  // The owner of the free entries, and the row of the classes without methods.
+  struct Row {
+    uint32_t refCount = 0;
+    std::vector<uint32_t> selectors;
+  };
+  std::vector<Obj*> methods;
+  std::vector<uint32_t> owners;
+  std::vector<Row> rows = std::vector<Row>(1);  // Indexed by the row ids, "NO_ROW" has no selectors.
+  std::vector<uint32_t> freeRows;
+  size_t firstFree = 0;  // No entry below it is free.
+  uint32_t acquire(uint32_t row) {
+    if (row != NO_ROW) rows[row].refCount++;
+    return row;
+  }
+  void release(uint32_t row, uint32_t base) {
+    if (row == NO_ROW || --rows[row].refCount > 0) return;
+    for (const auto selector : rows[row].selectors) {
+      const auto idx = base + selector;
+      methods[idx] = nullptr;
+      owners[idx] = NO_ROW;
+      firstFree = std::min<size_t>(firstFree, idx);
+    }
+    rows[row].selectors.clear();
+    freeRows.push_back(row);
+  }
+  /**
+   * Set the method of "selector" in the row (and its base) of a class, -
+   * a shared row is copied first, and a row whose entry is taken by another row moves to where all its selectors fit.
+  */
+  void set(uint32_t& row, uint32_t& base, uint32_t selector, Obj* method) {
+    if (row != NO_ROW && rows[row].refCount == 1) {
+      const auto idx = base + selector;
+      if (idx < owners.size() && owners[idx] == row) {
+        methods[idx] = method;
+        return;
+      }
+      if (idx >= owners.size() || owners[idx] == NO_ROW) {
+        claim(row, idx, method);
+        rows[row].selectors.push_back(selector);
+        return;
+      }
+    }
+    std::vector<std::pair<uint32_t, Obj*>> entries;
+    for (const auto inherited : rows[row].selectors) {
+      if (inherited != selector) entries.emplace_back(inherited, methods[base + inherited]);
+    }
+    entries.emplace_back(selector, method);
+    release(row, base);
+    if (row == NO_ROW || rows[row].refCount > 0) {
+      row = freeRows.empty() ? static_cast<uint32_t>(rows.size()) : freeRows.back();
+      if (freeRows.empty()) rows.emplace_back(); else freeRows.pop_back();
+    } else {
+      freeRows.pop_back();  // Moving an unshared row, it keeps its id.
+    }
+    rows[row].refCount = 1;
+    base = place(entries);
+    for (const auto& [entrySelector, entryMethod] : entries) {
+      claim(row, base + entrySelector, entryMethod);
+      rows[row].selectors.push_back(entrySelector);
+    }
+  }
+  Obj* find(uint32_t row, uint32_t base, uint32_t selector) const {
+    const auto idx = base + selector;  // Wraps around for the selectors below the base.
+    return idx < owners.size() && owners[idx] == row ? methods[idx] : nullptr;
+  }
+ private:
+  // The base (first fit from the lowest free entry) where no selector of "entries" lands on a taken entry.
+  uint32_t place(const std::vector<std::pair<uint32_t, Obj*>>& entries) const {
+    uint32_t lowest = UINT32_MAX;
+    for (const auto& entry : entries) lowest = std::min(lowest, entry.first);
+    for (auto start = firstFree;; start++) {
+      const auto base = static_cast<uint32_t>(start) - lowest;
+      bool fits = true;
+      for (const auto& entry : entries) {
+        const auto idx = base + entry.first;
+        if (idx < owners.size() && owners[idx] != NO_ROW) {
+          fits = false;
+          break;
+        }
+      }
+      if (fits) return base;
+    }
+  }
+  void claim(uint32_t row, uint32_t idx, Obj* method) {
+    if (idx >= owners.size()) {
+      owners.resize(idx + 1, NO_ROW);
+      methods.resize(idx + 1, nullptr);
+    }
+    owners[idx] = row;
+    methods[idx] = method;
+    while (firstFree < owners.size() && owners[firstFree] != NO_ROW) firstFree++;
+  }
+};
+
 struct ObjClass : public Obj {
   Obj* name;
-  typeVMStore<Obj*> methods;
+  /**
+   * Methods are indexed by the selectors of their names in the row of "dispatch" (displaced by "rowBase"), -
+   * so looking up a method is an index plus a bounds check.
+  */
+  DispatchTable* dispatch;
+  uint32_t row = DispatchTable::NO_ROW;
+  uint32_t rowBase = 0;
+  Obj* initializer = nullptr;  // The "init" method, cached for constructing instances.
+  uint32_t version = 0;  // Bumped whenever the methods change, which invalidates the inline cache entries of this class.
+  static constexpr uint32_t FIELD_COUNT_MAX = 64;  // An instance used as a map does not make the others reserve as much.
+  uint32_t fieldCount = 0;  // The most fields an instance of this class has had (up to "FIELD_COUNT_MAX"), new instances reserve that many.
   std::string toString(void) override {
     return "<class " + name->cast<ObjString>()->str + ">";
   }
-  ObjClass(Obj** next, Obj* name) : Obj(ObjType::OBJ_CLASS, *next), name(name) {
+  ObjClass(Obj** next, Obj* name, DispatchTable* dispatch) : Obj(ObjType::OBJ_CLASS, *next), name(name), dispatch(dispatch) {
     *next = this;
   }
-  ~ObjClass() {}
+  Obj* findMethod(Obj* name) const {
+    return dispatch->find(row, rowBase, name->cast<ObjString>()->selector);
+  }
+  void setMethod(Obj* name, Obj* method) {
+    dispatch->set(row, rowBase, name->cast<ObjString>()->selector, method);
+  }
+  void inherit(const ObjClass* superclass) {
+    dispatch->release(row, rowBase);
+    row = dispatch->acquire(superclass->row);
+    rowBase = superclass->rowBase;
+    initializer = superclass->initializer;
+  }
+  template<typename F>
+  void forEachMethod(F&& visit) const {
+    for (const auto selector : dispatch->rows[row].selectors) {
+      visit(dispatch->methods[rowBase + selector]);
+    }
+  }
+  ~ObjClass() {
+    dispatch->release(row, rowBase);
+  }
+};
+
+/**
+ * The hidden class of instances, it maps field names to the slots of "ObjInstance::fields".
+ * Instances adding the same fields in the same order share a shape, -
+ * shapes make up a transition tree rooted at the empty shape owned by the VM.
+*/
+struct ObjShape : public Obj {
+  static constexpr uint32_t NO_SLOT = UINT32_MAX;
+  static constexpr size_t LINEAR_SCAN_MAX = 8;  // Beyond this, looking up by "slotTable" is faster than scanning "keys".
+  ObjShape* parent;
+  std::vector<Obj*> keys;  // Field names, indexed by slot.
+  typeVMStore<uint32_t> slotTable;
+  typeVMStore<ObjShape*> transitions;  // Weak references, GC removes the unreached ones.
+  std::string toString(void) override {
+    return "<shape>";
+  }
+  ObjShape(Obj** next, ObjShape* parent = nullptr, Obj* key = nullptr) : Obj(ObjType::OBJ_SHAPE, *next), parent(parent) {
+    if (parent != nullptr) {
+      keys = parent->keys;
+      keys.push_back(key);
+    }
+    if (keys.size() > LINEAR_SCAN_MAX) {
+      for (uint32_t i = 0; i < keys.size(); i++) {
+        slotTable[keys[i]] = i;
+      }
+    }
+    *next = this;
+  }
+  uint32_t lookup(Obj* name) const {
+    if (keys.size() > LINEAR_SCAN_MAX) {
+      const auto it = slotTable.find(name);
+      return it == slotTable.end() ? NO_SLOT : it->second;
+    }
+    for (uint32_t i = 0; i < keys.size(); i++) {
+      if (keys[i] == name) return i;
+    }
+    return NO_SLOT;
+  }
+  ~ObjShape() {}
 };
 
 struct ObjInstance : public Obj {
   ObjClass* klass;
-  typeVMStore<> fields = {};
+  ObjShape* shape;
+  std::vector<VMValue> fields;  // Field values, indexed by the slots of "shape".
   std::string toString(void) override {
     return "<instance " + klass->name->cast<ObjString>()->str + ">";
   }
-  ObjInstance(Obj** next, ObjClass* klass) : Obj(ObjType::OBJ_INSTANCE, *next), klass(klass) {
+  ObjInstance(Obj** next, ObjClass* klass, ObjShape* shape) : Obj(ObjType::OBJ_INSTANCE, *next), klass(klass), shape(shape) {
+    fields.reserve(klass->fieldCount);
     *next = this;
   }
+  VMValue* findField(Obj* name) {
+    const auto slot = shape->lookup(name);
+    return slot == ObjShape::NO_SLOT ? nullptr : &fields[slot];
+  }
   ~ObjInstance() {}
 };
 
+inline auto isObjType(const VMValue& v, ObjType type) {
+  return v.isObj() && v.asObj()->type == type;
+}
+
 inline auto retrieveObjFunc(Obj* obj) { 
   return obj->type == ObjType::OBJ_FUNCTION ? obj->cast<ObjFunc>() : obj->cast<ObjClosure>()->function;  // Falling through to "ObjClosure".
 }
 
 struct ObjBoundMethod : public Obj {
-  typeRuntimeValue receiver;   // "ObjInstance*".
+  VMValue receiver;   // "ObjInstance*".
   Obj* method;
   std::string toString(void) override {
     const auto function = retrieveObjFunc(method);
     return "<fn " + (function->name == nullptr ? "script" : function->name->str) + ">";
   }
-  ObjBoundMethod(Obj** next, typeRuntimeValue& receiver, Obj* method) : Obj(ObjType::OBJ_BOUND_METHOD, *next), receiver(receiver), method(method) {
+  ObjBoundMethod(Obj** next, const VMValue& receiver, Obj* method) : Obj(ObjType::OBJ_BOUND_METHOD, *next), receiver(receiver), method(method) {
     *next = this;
   }
   ~ObjBoundMethod() {}
@@ -166,6 +362,7 @@ const char* Obj::printObjNameByType(void) {
   else if constexpr (std::is_same_v<K, ObjClass>) return "ObjClass";
   else if constexpr (std::is_same_v<K, ObjInstance>) return "ObjInstance";
   else if constexpr (std::is_same_v<K, ObjBoundMethod>) return "ObjBoundMethod";
+  else if constexpr (std::is_same_v<K, ObjShape>) return "ObjShape";
   return "Unknown Type";
 }
 
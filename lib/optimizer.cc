@@ -0,0 +1,305 @@
+#include <algorithm>
+#include "./optimizer.h"
+
+ChunkRewriter::ChunkRewriter(Chunk& chunk) :
+  chunk(chunk),
+  targetCount(chunk.code.size() + 1, 0),
+  deleted(chunk.code.size() + 1, false),
+  relocation(chunk.code.size() + 1, 0) {
+  for (size_t offset = 0; offset < chunk.code.size();) {
+    const auto size = chunk.instructionSize(offset);
+    instructions.push_back({ offset, size, chunk.code[offset] });
+    offset += size;
+  }
+  for (size_t idx = 0; idx < instructions.size(); idx++) {
+    if (Chunk::jumpDirection(instructions[idx].op) != 0) {
+      targetCount[jumpTarget(idx)]++;
+    }
+  }
+  for (const auto& table : chunk.switchTables) {
+    table.forEachTarget([this](size_t target) { targetCount[target]++; });
+  }
+}
+
+size_t ChunkRewriter::jumpTarget(size_t idx) const {
+  const auto& instruction = instructions[idx];
+  const auto end = instruction.offset + instruction.size;
+  const auto far = chunk.farJumps.find(instruction.offset);
+  if (far != chunk.farJumps.cend()) return far->second;
+  const auto jump = chunk.jumpOffset(instruction.offset);
+  return Chunk::jumpDirection(instruction.op) > 0 ? end + jump : end - jump;
+}
+
+bool ChunkRewriter::isTargetOfOthers(size_t idx, size_t jumpIdx) const {
+  const auto offset = instructions[idx].offset;
+  return targetCount[offset] > (jumpTarget(jumpIdx) == offset ? 1 : 0);
+}
+
+bool ChunkRewriter::hasTargetWithin(size_t from, size_t to) const {
+  for (auto idx = from + 1; idx < to && idx < instructions.size(); idx++) {
+    if (isJumpTarget(idx)) return true;
+  }
+  return false;
+}
+
+size_t ChunkRewriter::indexOf(size_t offset) const {
+  const auto it = std::lower_bound(
+    instructions.cbegin(),
+    instructions.cend(),
+    offset,
+    [](const Instruction& instruction, size_t offset) { return instruction.offset < offset; });
+  return (it != instructions.cend() && it->offset == offset) ? it - instructions.cbegin() : instructions.size();
+}
+
+/**
+ * For a "JUMP_IF_FALSE" (followed by a "POP" on its falling through path), find the index of the "POP" -
+ * at its target, which is reached through this jump only, or return "count()" if there is no such one.
+ * "if" and "while" / "for" conditions are compiled into this shape, -
+ * a fused instruction that pops the condition itself lets both of the "POP"s go.
+*/
+size_t ChunkRewriter::exclusiveExitPop(size_t jumpIdx) const {
+  const auto exitOffset = jumpTarget(jumpIdx);
+  const auto exitIdx = indexOf(exitOffset);
+  if (exitIdx == 0 ||
+    exitIdx >= count() ||
+    op(exitIdx) != OpCode::OP_POP ||
+    deleted[exitOffset] ||
+    isTargetOfOthers(exitIdx, jumpIdx)) return count();
+  const auto beforeExit = op(exitIdx - 1);
+  if (beforeExit != OpCode::OP_JUMP && beforeExit != OpCode::OP_LOOP) return count();  // The "POP" must not be reached by falling through.
+  return exitIdx;
+}
+
+void ChunkRewriter::emit(OpCodeType byte) {
+  output.addCode(byte, currentLine);
+}
+
+void ChunkRewriter::emitJump(size_t oldTarget, int direction, size_t width) {
+  fixups.push_back({ output.code.size(), oldTarget, direction, width, currentOffset });
+  for (size_t n = 0; n < width; n++) emit(0xff);
+}
+
+bool ChunkRewriter::rewrite(const std::function<size_t(ChunkRewriter&, size_t)>& matcher) {
+  for (size_t idx = 0; idx < instructions.size();) {
+    const auto& instruction = instructions[idx];
+    relocation[instruction.offset] = output.code.size();
+    if (deleted[instruction.offset]) {
+      idx++;
+      continue;
+    }
+    currentLine = chunk.getLine(instruction.offset);
+    currentOffset = instruction.offset;
+    const auto consumed = matcher(*this, idx);
+    if (consumed > 0) {
+      idx += consumed;
+      continue;
+    }
+    const auto direction = Chunk::jumpDirection(instruction.op);
+    const auto width = Chunk::jumpOperandSize(instruction.op);
+    const auto copied = direction != 0 ? instruction.size - width : instruction.size;
+    for (size_t n = 0; n < copied; n++) {
+      emit(chunk.code[instruction.offset + n]);
+    }
+    if (direction != 0) emitJump(jumpTarget(idx), direction, width);
+    idx++;
+  }
+  relocation[chunk.code.size()] = output.code.size();
+  for (const auto& fixup : fixups) {
+    const auto target = relocation[fixup.oldTarget];
+    const auto end = fixup.operandPos + fixup.width;
+    auto jump = fixup.direction > 0 ? target - end : end - target;
+    if (fixup.width == 2 && jump > UINT16_MAX) overflows.push_back(fixup.source);
+    for (auto pos = end; pos > fixup.operandPos; pos--, jump >>= 8) {
+      output.code[pos - 1] = jump & 0xff;
+    }
+  }
+  if (!overflows.empty()) return false;
+  chunk.code = std::move(output.code);
+  chunk.lines = std::move(output.lines);
+  chunk.farJumps.clear();
+  for (auto& table : chunk.switchTables) {
+    table.relocate(relocation);
+  }
+  return true;
+}
+
+/**
+ * Widen the jumps at the given (old) offsets:
+ *
+ *   JUMP | JUMP_IF_FALSE | LOOP X          ->  JUMP_LONG | JUMP_IF_FALSE_LONG | LOOP_LONG X
+ *   FOR_LOOP_<cmp>_<RR | RK> ... X         ->  JUMP +5; T: LOOP_LONG X; FOR_LOOP_<cmp>_<RR | RK> ... T
+ *
+ * A counted loop has no long form, it jumps back to a "LOOP_LONG" placed right before it.
+*/
+static size_t widenJump(ChunkRewriter& rw, size_t idx, const std::unordered_set<size_t>& wide) {
+  if (!wide.contains(rw.instructions[idx].offset)) return 0;
+  const auto target = rw.jumpTarget(idx);
+  switch (const auto op = rw.op(idx).value()) {
+    case OpCode::OP_JUMP:
+    case OpCode::OP_JUMP_IF_FALSE: {
+      rw.emit(op == OpCode::OP_JUMP ? OpCode::OP_JUMP_LONG : OpCode::OP_JUMP_IF_FALSE_LONG);
+      rw.emitJump(target, 1, 4);
+      return 1;
+    }
+    case OpCode::OP_LOOP: {
+      rw.emit(OpCode::OP_LOOP_LONG);
+      rw.emitJump(target, -1, 4);
+      return 1;
+    }
+    case OpCode::OP_FOR_LOOP_LESS_RR:
+    case OpCode::OP_FOR_LOOP_GREATER_RR:
+    case OpCode::OP_FOR_LOOP_LESS_RK:
+    case OpCode::OP_FOR_LOOP_GREATER_RK: {
+      for (const OpCodeType byte : std::initializer_list<OpCodeType> { OpCode::OP_JUMP, 0, 5, OpCode::OP_LOOP_LONG }) rw.emit(byte);
+      rw.emitJump(target, -1, 4);
+      rw.emit(op);
+      for (size_t n = 0; n < 3; n++) rw.emit(rw.operand(idx, n));
+      rw.emit(0);
+      rw.emit(11);  // Back over itself and the "LOOP_LONG".
+      return 1;
+    }
+    default: return 0;
+  }
+}
+
+/**
+ * The compiler records the jumps which don't fit in "Chunk::farJumps". -
+ * Widening one moves the code after it, which can push more jumps out of range, -
+ * so the pass starts over from the original code until every offset fits.
+*/
+void ChunkOptimizer::relaxJumps(Chunk& chunk) {
+  std::unordered_set<size_t> wide;
+  for (const auto& [offset, target] : chunk.farJumps) wide.insert(offset);
+  while (true) {
+    ChunkRewriter rw { chunk };
+    if (rw.rewrite([&wide](ChunkRewriter& rw, size_t idx) { return widenJump(rw, idx, wide); })) return;
+    wide.insert(rw.overflows.cbegin(), rw.overflows.cend());
+  }
+}
+
+static OpCodeType registerArithmetic(OpCodeType op, bool constantOperand) {
+  switch (op) {
+    case OpCode::OP_ADD: return constantOperand ? OpCode::OP_ADD_RK : OpCode::OP_ADD_RR;
+    case OpCode::OP_SUBTRACT: return constantOperand ? OpCode::OP_SUBTRACT_RK : OpCode::OP_SUBTRACT_RR;
+    case OpCode::OP_MULTIPLY: return constantOperand ? OpCode::OP_MULTIPLY_RK : OpCode::OP_MULTIPLY_RR;
+    case OpCode::OP_DIVIDE: return constantOperand ? OpCode::OP_DIVIDE_RK : OpCode::OP_DIVIDE_RR;
+    case OpCode::OP_LESS: return constantOperand ? OpCode::OP_JUMP_IF_NOT_LESS_RK : OpCode::OP_JUMP_IF_NOT_LESS_RR;
+    case OpCode::OP_GREATER: return constantOperand ? OpCode::OP_JUMP_IF_NOT_GREATER_RK : OpCode::OP_JUMP_IF_NOT_GREATER_RR;
+    default: return op;
+  }
+}
+
+/**
+ * Patterns (left) and their register forms (right):
+ *
+ *   GET_LOCAL a; GET_LOCAL b | CONSTANT k; <arith>; SET_LOCAL d; POP   ->  <arith>_RR d a b | <arith>_RK d a k
+ *   GET_LOCAL a; SET_LOCAL d; POP                                       ->  MOVE d a
+ *   CONSTANT k; SET_LOCAL d; POP                                        ->  LOAD_CONSTANT d k
+ *   GET_LOCAL a; GET_LOCAL b | CONSTANT k; LESS | GREATER;
+ *   JUMP_IF_FALSE X; POP; ...; X: POP                                   ->  JUMP_IF_NOT_<cmp>_RR a b | _RK a k (X + 1)
+ *
+ * The last one only applies when the "POP" at X is reachable from the conditional jump only, -
+ * which is the shape "if" and "while" / "for" conditions are compiled into.
+*/
+static size_t lowerRegisterPattern(ChunkRewriter& rw, size_t idx) {
+  const auto op = rw.op(idx).value();
+  const auto isSetLocalPop = [&](size_t at) {
+    return rw.op(at) == OpCode::OP_SET_LOCAL && rw.op(at + 1) == OpCode::OP_POP;
+  };
+  if ((op == OpCode::OP_GET_LOCAL || op == OpCode::OP_CONSTANT) && isSetLocalPop(idx + 1) && !rw.hasTargetWithin(idx, idx + 3)) {
+    rw.emit(op == OpCode::OP_GET_LOCAL ? OpCode::OP_MOVE : OpCode::OP_LOAD_CONSTANT);
+    rw.emit(rw.operand(idx + 1));
+    rw.emit(rw.operand(idx));
+    return 3;
+  }
+  if (op != OpCode::OP_GET_LOCAL) return 0;
+  const auto rhs = rw.op(idx + 1);
+  if (rhs != OpCode::OP_GET_LOCAL && rhs != OpCode::OP_CONSTANT) return 0;
+  const auto binary = rw.op(idx + 2);
+  if (!binary.has_value()) return 0;
+  const auto lowered = registerArithmetic(binary.value(), rhs == OpCode::OP_CONSTANT);
+  if (lowered == binary) return 0;
+  if (binary == OpCode::OP_LESS || binary == OpCode::OP_GREATER) {
+    if (rw.op(idx + 3) != OpCode::OP_JUMP_IF_FALSE || rw.op(idx + 4) != OpCode::OP_POP || rw.hasTargetWithin(idx, idx + 5)) return 0;
+    const auto exitIdx = rw.exclusiveExitPop(idx + 3);
+    if (exitIdx == rw.count()) return 0;
+    rw.emit(lowered);
+    rw.emit(rw.operand(idx));
+    rw.emit(rw.operand(idx + 1));
+    rw.emitJump(rw.jumpTarget(idx + 3) + 1, 1);
+    rw.drop(exitIdx);
+    return 5;
+  }
+  if (!isSetLocalPop(idx + 3) || rw.hasTargetWithin(idx, idx + 5)) return 0;
+  rw.emit(lowered);
+  rw.emit(rw.operand(idx + 3));
+  rw.emit(rw.operand(idx));
+  rw.emit(rw.operand(idx + 1));
+  return 5;
+}
+
+void ChunkOptimizer::lowerToRegisters(Chunk& chunk) {
+  ChunkRewriter { chunk }.rewrite(lowerRegisterPattern);
+}
+
+/**
+ * Superinstructions, the sequences are picked from the opcode n-gram profile (see "profiler.h"):
+ *
+ *   GET_LOCAL a; GET_LOCAL b; ADD                      ->  ADD_LOCAL_LOCAL a b
+ *   GET_LOCAL a; CONSTANT k; ADD | SUBTRACT | LESS     ->  <op>_LOCAL_CONSTANT a k
+ *   SET_LOCAL a; POP                                   ->  SET_LOCAL_POP a
+ *   GET_GLOBAL g; CALL 0                               ->  CALL_GLOBAL g
+ *   JUMP_IF_FALSE X; POP; ...; X: POP                  ->  POP_JUMP_IF_FALSE (X + 1)
+*/
+static size_t fuseSuperinstruction(ChunkRewriter& rw, size_t idx) {
+  switch (rw.op(idx).value()) {
+    case OpCode::OP_GET_LOCAL: {
+      if (rw.hasTargetWithin(idx, idx + 3)) return 0;
+      OpCodeType fused = OpCode::OP_GET_LOCAL;
+      if (rw.op(idx + 1) == OpCode::OP_GET_LOCAL && rw.op(idx + 2) == OpCode::OP_ADD) {
+        fused = OpCode::OP_ADD_LOCAL_LOCAL;
+      } else if (const auto binary = rw.op(idx + 2); rw.op(idx + 1) == OpCode::OP_CONSTANT && binary.has_value()) {
+        switch (binary.value()) {
+          case OpCode::OP_ADD: fused = OpCode::OP_ADD_LOCAL_CONSTANT; break;
+          case OpCode::OP_SUBTRACT: fused = OpCode::OP_SUBTRACT_LOCAL_CONSTANT; break;
+          case OpCode::OP_LESS: fused = OpCode::OP_LESS_LOCAL_CONSTANT; break;
+          default: ;
+        }
+      }
+      if (fused == OpCode::OP_GET_LOCAL) return 0;
+      rw.emit(fused);
+      rw.emit(rw.operand(idx));
+      rw.emit(rw.operand(idx + 1));
+      return 3;
+    }
+    case OpCode::OP_SET_LOCAL: {
+      if (rw.op(idx + 1) != OpCode::OP_POP || rw.hasTargetWithin(idx, idx + 2)) return 0;
+      rw.emit(OpCode::OP_SET_LOCAL_POP);
+      rw.emit(rw.operand(idx));
+      return 2;
+    }
+    case OpCode::OP_GET_GLOBAL: {
+      if (rw.op(idx + 1) != OpCode::OP_CALL || rw.operand(idx + 1) != 0 || rw.hasTargetWithin(idx, idx + 2)) return 0;
+      rw.emit(OpCode::OP_CALL_GLOBAL);
+      rw.emit(rw.operand(idx));
+      rw.emit(rw.operand(idx, 1));
+      rw.emit(rw.operand(idx + 1, 1));  // The call cache.
+      rw.emit(rw.operand(idx + 1, 2));
+      return 2;
+    }
+    case OpCode::OP_JUMP_IF_FALSE: {
+      if (rw.op(idx + 1) != OpCode::OP_POP || rw.hasTargetWithin(idx, idx + 2)) return 0;
+      const auto exitIdx = rw.exclusiveExitPop(idx);
+      if (exitIdx == rw.count()) return 0;
+      rw.emit(OpCode::OP_POP_JUMP_IF_FALSE);
+      rw.emitJump(rw.jumpTarget(idx) + 1, 1);
+      rw.drop(exitIdx);
+      return 2;
+    }
+    default: return 0;
+  }
+}
+
+void ChunkOptimizer::fuseSuperinstructions(Chunk& chunk) {
+  ChunkRewriter { chunk }.rewrite(fuseSuperinstruction);
+}
@@ -0,0 +1,83 @@
+#ifndef	_OPTIMIZER_H
+#define	_OPTIMIZER_H
+
+/**
+ * Post-passes over the byte code of a compiled chunk.
+ *
+ * A pass walks the decoded instructions and tries to match a pattern at each of them, -
+ * a matched sequence is replaced by new code, an unmatched instruction is copied as is.
+ * All jumps (including the ones inside the new code) and the targets of the switch tables are relocated, -
+ * and the line information is rebuilt.
+ * A pass only makes code shorter, except for "relaxJumps", which widens the jumps whose offsets don't fit in 16 bits.
+*/
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <optional>
+#include <unordered_set>
+#include "./chunk.h"
+#include "./type.h"
+
+struct ChunkRewriter {
+  struct Instruction {
+    size_t offset;
+    size_t size;
+    OpCodeType op;
+  };
+  struct JumpFixup {
+    size_t operandPos;  // Position of the offset in the new code.
+    size_t oldTarget;  // The jump destination in the old code.
+    int direction;
+    size_t width;  // The size of the offset, two bytes (four for the long forms).
+    size_t source;  // The old offset of the instruction that was rewritten into the jump.
+  };
+  Chunk& chunk;
+  std::vector<Instruction> instructions;
+  std::vector<size_t> targetCount;  // How many jumps land on each offset of the old code.
+  std::vector<bool> deleted;  // Instructions (by old offset) that a pattern asked to drop.
+  Chunk output;  // The rewritten code and its line information.
+  std::vector<size_t> relocation;  // Old offset -> new offset.
+  std::vector<JumpFixup> fixups;
+  std::vector<size_t> overflows;  // The sources of the 16-bit offsets which don't fit after the relocation.
+  size_t currentLine = 0;
+  size_t currentOffset = 0;  // The old offset of the instruction being rewritten.
+  explicit ChunkRewriter(Chunk&);
+  auto count(void) const {
+    return instructions.size();
+  }
+  // Nothing past the last instruction, so a pattern looking ahead never matches beyond the end of the chunk.
+  std::optional<OpCodeType> op(size_t idx) const {
+    return idx < instructions.size() ? std::make_optional(instructions[idx].op) : std::nullopt;
+  }
+  OpCodeType operand(size_t idx, size_t n = 0) const {
+    return chunk.code[instructions[idx].offset + 1 + n];
+  }
+  size_t jumpTarget(size_t idx) const;
+  bool isJumpTarget(size_t idx) const {
+    return targetCount[instructions[idx].offset] > 0;
+  }
+  bool isTargetOfOthers(size_t idx, size_t jumpIdx) const;  // Whether any jump other than "jumpIdx" lands on "idx".
+  bool hasTargetWithin(size_t from, size_t to) const;  // Whether any of instructions (from, to) is a jump target.
+  size_t indexOf(size_t offset) const;
+  size_t exclusiveExitPop(size_t) const;
+  void emit(OpCodeType byte);
+  void emitJump(size_t oldTarget, int direction, size_t width = 2);  // Emit a jump offset, patched once relocation is known.
+  void drop(size_t idx) {
+    deleted[instructions[idx].offset] = true;
+  }
+  /**
+   * The matcher is invoked on each instruction index, it returns how many instructions it consumed -
+   * (with the replacement emitted), or zero for leaving the instruction unchanged.
+   * The chunk is left as is when a relocated offset overflows (see "overflows"), return whether it was rewritten.
+  */
+  bool rewrite(const std::function<size_t(ChunkRewriter&, size_t)>&);
+};
+
+struct ChunkOptimizer {
+  static void relaxJumps(Chunk&);
+  static void lowerToRegisters(Chunk&);
+  static void fuseSuperinstructions(Chunk&);
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <algorithm>
 #include "./token.h"
 #include "./expr.h"
 #include "./stmt.h"
@@ -35,17 +36,22 @@ class Parser {
   auto check(const TokenType& type) {
     return isAtEnd() ? false : peek().type == type;
   }
+  auto isMinusNegate(void) {  // The "--" after an operand, see "startsPrimary".
+    return check(TokenType::MINUS_MINUS) && startsPrimary((current + 1)->type);
+  }
   void synchronize(void) {
     advance();
     while (!isAtEnd()) {
       if (previous().type == TokenType::SEMICOLON) return;
       switch (peek().type) {  // Check if it's the statement boundary.
         case TokenType::CLASS:
+        case TokenType::CONST:
         case TokenType::FN:
         case TokenType::VAR:
         case TokenType::FOR:
         case TokenType::IF:
         case TokenType::WHILE:
+        case TokenType::SWITCH:
         case TokenType::RETURN:
           return;
         default: ;
@@ -83,6 +89,14 @@ class Parser {
     consume(TokenType::SEMICOLON, "expect ';' after variable declaration.");
     return std::make_shared<VarStmt>(name, initializer);
   }
+  Stmt::sharedStmtPtr constDeclaration(void) {
+    // constDecl → "const" IDENTIFIER "=" expression ";" ;
+    auto& name = consume(TokenType::IDENTIFIER, "expect constant name.");
+    consume(TokenType::EQUAL, "expect '=' after constant name.");
+    const auto initializer = expression();
+    consume(TokenType::SEMICOLON, "expect ';' after constant declaration.");
+    return std::make_shared<VarStmt>(name, initializer, true);
+  }
   Stmt::sharedStmtPtr classDeclaration(void) {
     // classDecl → "class" IDENTIFIER ( "<" IDENTIFIER )?  "{" function* "}" ;
     auto& name = consume(TokenType::IDENTIFIER, "expect class name.");
@@ -124,6 +138,7 @@ class Parser {
       if (match(TokenType::CLASS)) return classDeclaration();
       if (match(TokenType::FN)) return function("function");
       if (match(TokenType::VAR)) return varDeclaration();
+      if (match(TokenType::CONST)) return constDeclaration();
       return statement();  // Any place where a declaration is allowed also allows non-declaring statements.
     } catch (const ParseError& parserError) {
       synchronize();  // Get into panic mode, and have the synchronization to find the beginning of the next legal statement.
@@ -189,6 +204,51 @@ class Parser {
     }
     return body;
   }
+  typeRuntimeValue caseLabel(void) {
+    // label → "-"? NUMBER | STRING | "true" | "false" | "nil" ;
+    if (match(TokenType::MINUS)) {
+      consume(TokenType::NUMBER, "expect a literal after 'case'.");
+      return -std::get<typeRuntimeNumericValue>(previous().literal);
+    }
+    if (match({ TokenType::NUMBER, TokenType::STRING, })) return previous().literal;
+    if (match(TokenType::TRUE)) return true;
+    if (match(TokenType::FALSE)) return false;
+    if (match(TokenType::NIL)) return std::monostate {};
+    throw error(peek(), "expect a literal after 'case'.");
+  }
+  auto switchStatement(void) {
+    // switchStmt → "switch" "(" expression ")" "{" switchCase* "}" ;
+    // switchCase → ( ( "case" label | "default" ) ":" )+ declaration* ;
+    consume(TokenType::LEFT_PAREN, "expect '(' after 'switch'.");
+    auto value = expression();
+    consume(TokenType::RIGHT_PAREN, "expect ')' after switch value.");
+    consume(TokenType::LEFT_BRACE, "expect '{' before switch cases.");
+    std::vector<SwitchStmt::Case> cases;
+    std::vector<typeRuntimeValue> labels;
+    auto hasDefault = false;
+    while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+      SwitchStmt::Case switchCase;
+      do {  // Labels in a row share the body.
+        if (match(TokenType::CASE)) {
+          const auto label = caseLabel();
+          if (std::find(labels.cbegin(), labels.cend(), label) != labels.cend()) error(previous(), "duplicate case label.");
+          labels.push_back(label);
+          switchCase.labels.push_back(label);
+        } else {
+          consume(TokenType::DEFAULT, "expect 'case' or 'default'.");
+          if (hasDefault) error(previous(), "duplicate default case.");
+          hasDefault = switchCase.isDefault = true;
+        }
+        consume(TokenType::COLON, "expect ':' after case label.");
+      } while (check(TokenType::CASE) || check(TokenType::DEFAULT));
+      while (!check(TokenType::CASE) && !check(TokenType::DEFAULT) && !check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+        switchCase.body.push_back(declaration());
+      }
+      cases.push_back(switchCase);
+    }
+    consume(TokenType::RIGHT_BRACE, "expect '}' after switch cases.");
+    return std::make_shared<SwitchStmt>(value, cases);
+  }
   auto returnStatement(void) {
     // returnStmt → "return" expression? ";" ;
     const auto& keyword = previous();
@@ -219,11 +279,13 @@ class Parser {
     //           | forStmt
     //           | ifStmt
     //           | whileStmt
+    //           | switchStmt
     //           | block ;
     if (match(TokenType::FOR)) return forStatement();
     if (match(TokenType::IF)) return ifStatement();
     if (match(TokenType::RETURN)) return returnStatement();
     if (match(TokenType::WHILE)) return whileStatement();
+    if (match(TokenType::SWITCH)) return switchStatement();
     if (match(TokenType::LEFT_BRACE)) return std::make_shared<BlockStmt>(block());
     /**
      * If the next token doesn’t look like any known kind of statement, -
@@ -284,9 +346,26 @@ class Parser {
         return std::make_shared<SetExpr>(castPtr->obj, castPtr->name, value);
       }
       error(equals, "invalid assignment target.");
+    } else if (match({ TokenType::PLUS_EQUAL, TokenType::MINUS_EQUAL, })) {
+      const auto& op = previous();
+      auto value = assignment();
+      return compoundTarget(expr, op, value);
     }
     return expr;
   }
+  /**
+   * Turn the target of "+=" / "-=" / "++" / "--" into the compound assignment node, -
+   * "isPrefix" for the prefix "++" / "--" which evaluate to the new value.
+  */
+  Expr::sharedExprPtr compoundTarget(Expr::sharedExprPtr expr, const Token& op, Expr::sharedExprPtr value, bool isPrefix = false) {
+    if (auto castPtr = std::dynamic_pointer_cast<VariableExpr>(expr)) {
+      return std::make_shared<CompoundAssignExpr>(castPtr->name, op, value, isPrefix);
+    } else if (auto castPtr = std::dynamic_pointer_cast<GetExpr>(expr)) {
+      return std::make_shared<CompoundSetExpr>(castPtr->obj, castPtr->name, op, value, isPrefix);
+    }
+    error(op, "invalid assignment target.");
+    return expr;
+  }
   Expr::sharedExprPtr expression(void) {
     // expression → assignment ;
     return assignment();
@@ -312,10 +391,11 @@ class Parser {
     return expr;
   }
   Expr::sharedExprPtr term(void) {
-    // term → factor ( ( "-" | "+" ) factor )* ;
+    // term → factor ( ( "-" | "+" | "--" ) factor )* ;
     // Addition and subtraction go first, and then multiplication and division.
+    // A "--" left here by "postfix" is a minus and a negation of the right operand.
     auto expr = factor();
-    while (match({ TokenType::MINUS, TokenType::PLUS, })) {
+    while (match({ TokenType::MINUS, TokenType::PLUS, TokenType::MINUS_MINUS, })) {
       const auto& op = previous();
       auto right = factor();
       expr = std::make_shared<BinaryExpr>(expr, op, right);
@@ -333,13 +413,31 @@ class Parser {
     return expr;
   }
   Expr::sharedExprPtr unary(void) {
-    // unary → ( "!" | "-" ) unary | call ;
+    // unary → ( "!" | "-" | "++" | "--" ) unary | postfix ;
     if (match({ TokenType::BANG, TokenType::MINUS, })) {
       const auto& op = previous();
       auto right = unary();
       return std::make_shared<UnaryExpr>(op, right);
     }
-    return call();
+    if (match({ TokenType::PLUS_PLUS, TokenType::MINUS_MINUS, })) {
+      const auto& op = previous();
+      auto right = unary();
+      if (std::dynamic_pointer_cast<VariableExpr>(right) != nullptr || std::dynamic_pointer_cast<GetExpr>(right) != nullptr) {
+        return compoundTarget(right, op, std::make_shared<LiteralExpr>(1.0), true);
+      }
+      if (op.type == TokenType::PLUS_PLUS) error(op, "invalid assignment target.");
+      return std::make_shared<UnaryExpr>(op, right);  // A "--" on a value which can't be assigned negates twice.
+    }
+    return postfix();
+  }
+  Expr::sharedExprPtr postfix(void) {
+    // postfix → call ( "++" | "--" )? ;
+    auto expr = call();
+    if (!isMinusNegate() && match({ TokenType::PLUS_PLUS, TokenType::MINUS_MINUS, })) {
+      const auto& op = previous();
+      return compoundTarget(expr, op, std::make_shared<LiteralExpr>(1.0));
+    }
+    return expr;
   }
   Expr::sharedExprPtr call(void) {
     // call → primary ( "(" arguments? ")" | "." IDENTIFIER )* ;
@@ -0,0 +1,49 @@
+#ifndef	_PROFILER_H
+#define	_PROFILER_H
+
+/**
+ * Counting the executed opcode n-grams (bigrams and trigrams), for choosing superinstructions.
+ * Only sequences whose instructions are adjacent in the code are counted, -
+ * a taken jump, a call or a return starts a new sequence since it can't be fused anyway.
+*/
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include "./chunk.h"
+
+struct OpcodeProfiler {
+  std::unordered_map<uint32_t, size_t> bigrams;
+  std::unordered_map<uint32_t, size_t> trigrams;
+  uint32_t history = 0;  // The latest three opcodes, one per byte.
+  size_t historyLength = 0;
+  const OpCodeType* expected = nullptr;  // Where the instruction following the previous one starts.
+  void record(const Chunk& chunk, typeVMCodeArray::const_iterator ip) {
+    const auto at = &*ip;
+    if (at != expected) historyLength = 0;
+    history = ((history << 8) | *ip) & 0xffffff;
+    historyLength++;
+    if (historyLength >= 2) bigrams[history & 0xffff]++;
+    if (historyLength >= 3) trigrams[history]++;
+    expected = at + chunk.instructionSize(ip - chunk.code.cbegin());
+  }
+  static void report(const char* kind, const std::unordered_map<uint32_t, size_t>& counts, size_t n) {
+    std::vector<std::pair<uint32_t, size_t>> sorted(counts.cbegin(), counts.cend());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    for (const auto& [ngram, count] : sorted) {
+      fprintf(stderr, "%s %12zu ", kind, count);
+      for (auto i = n; i >= 1; i--) {
+        fprintf(stderr, " %s", ChunkDebugger::opcodeName((ngram >> ((i - 1) * 8)) & 0xff));
+      }
+      fprintf(stderr, "\n");
+    }
+  }
+  void report(void) const {
+    report("[bigram] ", bigrams, 2);
+    report("[trigram]", trigrams, 3);
+  }
+};
+
+#endif
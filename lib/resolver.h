@@ -4,6 +4,8 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <unordered_set>
+#include <unordered_map>
 #include "./expr.h"
 #include "./stmt.h"
 #include "./interpreter.h"
@@ -17,9 +19,9 @@
  * 
  * - BlockStmt: new scope.
  * - FunctionStmt: new scope, new variables (parameters).
- * - VarStmt: new variables.
+ * - VarStmt: new variables (or constants).
  * - VariableExpr: bind local.
- * - AssignExpr: bind local (lvalue).
+ * - AssignExpr: bind local (lvalue), which must not be a constant.
  * - ThisExpr: bind "this".
  * 
 */
@@ -28,6 +30,8 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
   FunctionType currentFunction = FunctionType::NONE;
   ClassType currentClass = ClassType::NONE;
   std::vector<typeScopeRecord> scopes {};  // For tracking local block scopes.
+  std::vector<std::unordered_set<std::string_view>> constants { {} };  // The names declared by "const", at the top level and in each scope.
+  std::unordered_map<std::string_view, const Token*> globalAssignments;  // The first assignment of each global, a later "const" can't declare it.
   explicit Resolver(Interpreter& interpreter) : interpreter(interpreter) {}
   void resolve(Stmt::sharedStmtPtr stmt) {
     stmt->accept(this);
@@ -42,13 +46,20 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
   }
   void beginScope(void) {
     scopes.push_back(typeScopeRecord {});
+    constants.emplace_back();
   }
   void endScope(void) {
     scopes.pop_back();
+    constants.pop_back();
   }
   void declare(const Token& name) {
     // Add the variable to the innermost scope so that it shadows any outer one.
-    if (scopes.empty()) return;
+    if (scopes.empty()) {
+      if (constants.front().contains(name.lexeme)) {
+        Error::error(name, "already a constant with this name.");  // Globals may be redefined, but not the constant ones.
+      }
+      return;
+    }
     auto& scope = scopes.back();
     if (scope.contains(name.lexeme)) {
       Error::error(name, "already a variable with this name in this scope.");
@@ -59,6 +70,18 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
     if (scopes.empty()) return;
     scopes.back()[name.lexeme] = true;  // Mark as "fully initialized".
   }
+  /**
+   * The innermost declaration of the name decides, a variable may shadow a constant of an outer scope.
+  */
+  void checkAssignable(const Token& name) {
+    auto depth = scopes.size();
+    while (depth >= 1 && !scopes.at(depth - 1).contains(name.lexeme)) depth--;
+    if (constants.at(depth).contains(name.lexeme)) {
+      Error::error(name, "can't assign to a constant.");
+    } else if (depth == 0) {
+      globalAssignments.try_emplace(name.lexeme, &name);
+    }
+  }
   void resolveLocal(Expr::sharedConstExprPtr expr, const Token& name) {
     // Start at the innermost scope and work outwards, looking in each map for a matching name.
     for (auto i = scopes.size(); i >= 1; i--) {
@@ -101,6 +124,10 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
       resolve(stmt->initializer);  // Bind the variable expressions then.
     }
     define(stmt->name);
+    if (stmt->isConst && scopes.empty() && globalAssignments.contains(stmt->name.lexeme)) {
+      Error::error(*globalAssignments[stmt->name.lexeme], "can't assign to a constant.");  // Resolved before the declaration.
+    }
+    if (stmt->isConst) constants.back().insert(stmt->name.lexeme);
   }
   void visitFunctionStmt(std::shared_ptr<const FunctionStmt> stmt) override {
     declare(stmt->name);  // Enable recursion by defining the name before resolving the function’s body.
@@ -130,6 +157,14 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
     resolve(stmt->condition);
     resolve(stmt->body);
   }
+  void visitSwitchStmt(std::shared_ptr<const SwitchStmt> stmt) override {
+    resolve(stmt->value);
+    for (const auto& switchCase : stmt->cases) {
+      beginScope();
+      resolve(switchCase.body);
+      endScope();
+    }
+  }
   void visitClassStmt(std::shared_ptr<const ClassStmt> stmt) override {
     ClassType enclosingClass = currentClass;
     currentClass = ClassType::CLASS;
@@ -160,18 +195,29 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
     resolve(expr->obj);
     return std::monostate {};
   }
-  typeRuntimeValue visitVariableExpr(std::shared_ptr<const VariableExpr> expr) override { 
+  void checkOwnInitializer(const Token& name) {
     if (!scopes.empty()) {
-      const auto& exist = scopes.back().find(expr->name.lexeme);
+      const auto& exist = scopes.back().find(name.lexeme);
       if (exist != scopes.back().end() && !exist->second) {  // Check if the variable is being accessed inside its own initializer.
-        Error::error(expr->name, "can't read local variable in its own initializer.");
+        Error::error(name, "can't read local variable in its own initializer.");
       }
     }
+  }
+  typeRuntimeValue visitVariableExpr(std::shared_ptr<const VariableExpr> expr) override { 
+    checkOwnInitializer(expr->name);
+    resolveLocal(expr, expr->name);
+    return std::monostate {};
+  }
+  typeRuntimeValue visitCompoundAssignExpr(std::shared_ptr<const CompoundAssignExpr> expr) override {
+    resolve(expr->value);
+    checkOwnInitializer(expr->name);  // The variable is read as well.
+    checkAssignable(expr->name);
     resolveLocal(expr, expr->name);
     return std::monostate {};
   }
   typeRuntimeValue visitAssignExpr(std::shared_ptr<const AssignExpr> expr) override {
     resolve(expr->value);  // Resolve the value expression.
+    checkAssignable(expr->name);
     resolveLocal(expr, expr->name);
     return std::monostate {};
   }
@@ -209,6 +255,11 @@ struct Resolver : public ExprVisitor, public StmtVisitor {
     resolve(expr->obj);
     return std::monostate {};
   }
+  typeRuntimeValue visitCompoundSetExpr(std::shared_ptr<const CompoundSetExpr> expr) override {
+    resolve(expr->value);
+    resolve(expr->obj);
+    return std::monostate {};
+  }
   typeRuntimeValue visitSuperExpr(std::shared_ptr<const SuperExpr> expr) override {
     if (currentClass == ClassType::NONE) {
       Error::error(expr->keyword, "can't use 'super' outside of a class.");
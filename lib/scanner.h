@@ -23,7 +23,17 @@ class Scanner {
   TokenType identifierType(void) const {  // Identify identifier with a trie (a special kind of DFA).
     switch (*start) {
       case 'a': return checkKeyword(1, "nd", TokenType::AND);
-      case 'c': return checkKeyword(1, "lass", TokenType::CLASS);
+      case 'c': {
+        if (current - start > 1) {
+          switch (*(start + 1)) {
+            case 'a': return checkKeyword(2, "se", TokenType::CASE);
+            case 'l': return checkKeyword(2, "ass", TokenType::CLASS);
+            case 'o': return checkKeyword(2, "nst", TokenType::CONST);
+          }
+        }
+        break;
+      }
+      case 'd': return checkKeyword(1, "efault", TokenType::DEFAULT);
       case 'e': return checkKeyword(1, "lse", TokenType::ELSE);
       case 'f': {
         if (current - start > 1) {
@@ -39,7 +49,15 @@ class Scanner {
       case 'n': return checkKeyword(1, "il", TokenType::NIL);
       case 'o': return checkKeyword(1, "r", TokenType::OR);
       case 'r': return checkKeyword(1, "eturn", TokenType::RETURN);
-      case 's': return checkKeyword(1, "uper", TokenType::SUPER);
+      case 's': {
+        if (current - start > 1) {
+          switch (*(start + 1)) {
+            case 'u': return checkKeyword(2, "per", TokenType::SUPER);
+            case 'w': return checkKeyword(2, "itch", TokenType::SWITCH);
+          }
+        }
+        break;
+      }
       case 't': {
         if (current - start > 1) {
           switch (*(start + 1)) {
@@ -131,13 +149,14 @@ class Scanner {
       case '{': addToken(TokenType::LEFT_BRACE); break;
       case '}': addToken(TokenType::RIGHT_BRACE); break;
       case ',': addToken(TokenType::COMMA); break;
+      case ':': addToken(TokenType::COLON); break;
       case '.': {
-        if (isDigit(peekNext())) scanNumber();
+        if (!isAtEnd() && isDigit(*current)) scanNumber();  // A leading-dot number, e.g. ".5".
         else addToken(TokenType::DOT);
         break;
       }
-      case '-': addToken(TokenType::MINUS); break;
-      case '+': addToken(TokenType::PLUS); break;
+      case '-': addToken(forwardMatch('-') ? TokenType::MINUS_MINUS : forwardMatch('=') ? TokenType::MINUS_EQUAL : TokenType::MINUS); break;
+      case '+': addToken(forwardMatch('+') ? TokenType::PLUS_PLUS : forwardMatch('=') ? TokenType::PLUS_EQUAL : TokenType::PLUS); break;
       case ';': addToken(TokenType::SEMICOLON); break;
       case '*': addToken(TokenType::STAR); break; 
       // Maximal munch.
@@ -15,6 +15,7 @@ struct WhileStmt;
 struct FunctionStmt;
 struct ReturnStmt;
 struct ClassStmt;
+struct SwitchStmt;
 
 struct StmtVisitor {
   virtual void visitExpressionStmt(std::shared_ptr<const ExpressionStmt>) = 0;
@@ -25,6 +26,7 @@ struct StmtVisitor {
   virtual void visitFunctionStmt(std::shared_ptr<const FunctionStmt>) = 0;
   virtual void visitReturnStmt(std::shared_ptr<const ReturnStmt>) = 0;
   virtual void visitClassStmt(std::shared_ptr<const ClassStmt>) = 0;
+  virtual void visitSwitchStmt(std::shared_ptr<const SwitchStmt>) = 0;
   virtual ~StmtVisitor() {}
 };
 
@@ -46,7 +48,8 @@ struct ExpressionStmt : public Stmt, public std::enable_shared_from_this<Express
 struct VarStmt : public Stmt, public std::enable_shared_from_this<VarStmt> {
   const Token& name;
   const Expr::sharedExprPtr initializer;
-  VarStmt(const Token& name, Expr::sharedExprPtr initializer) : name(name), initializer(initializer) {}
+  const bool isConst;  // Declared by "const", it can't be assigned afterwards.
+  VarStmt(const Token& name, Expr::sharedExprPtr initializer, bool isConst = false) : name(name), initializer(initializer), isConst(isConst) {}
   void accept(StmtVisitor* visitor) override {
     visitor->visitVarStmt(shared_from_this());
   }
@@ -108,5 +111,19 @@ struct ClassStmt : public Stmt, public std::enable_shared_from_this<ClassStmt> {
   }
 };
 
+struct SwitchStmt : public Stmt, public std::enable_shared_from_this<SwitchStmt> {
+  struct Case {
+    std::vector<typeRuntimeValue> labels;  // The literals of the labels in a row, which share the body.
+    bool isDefault = false;  // Whether "default" is one of them.
+    std::vector<sharedStmtPtr> body;  // Runs in a scope of its own, never falls through into the next case.
+  };
+  const Expr::sharedExprPtr value;
+  const std::vector<Case> cases;
+  SwitchStmt(Expr::sharedExprPtr value, const std::vector<Case>& cases) : value(value), cases(cases) {}
+  void accept(StmtVisitor* visitor) override {
+    visitor->visitSwitchStmt(shared_from_this());
+  }
+};
+
 
 #endif
@@ -20,4 +20,23 @@ struct Token {
   Token(const TokenType& type, const std::string_view lexeme, const typeRuntimeValue& literal, size_t line) : type(type), lexeme(lexeme), literal(literal), line(line) {}
 };
 
+/**
+ * Whether a token can start a primary expression. A "--" right after an operand is a minus and a negation -
+ * when such a token follows it (as in "a--b"), and a postfix decrement otherwise (as in "a--;" or "a-- - 1").
+*/
+inline bool startsPrimary(TokenType type) {
+  switch (type) {
+    case TokenType::IDENTIFIER:
+    case TokenType::NUMBER:
+    case TokenType::STRING:
+    case TokenType::TRUE:
+    case TokenType::FALSE:
+    case TokenType::NIL:
+    case TokenType::THIS:
+    case TokenType::SUPER:
+    case TokenType::LEFT_PAREN: return true;
+    default: return false;
+  }
+}
+
 #endif
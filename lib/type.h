@@ -13,6 +13,7 @@
 #include <unordered_map>
 #include <iostream>
 #include "./common.h"
+#include "./value.h"
 
 using typeRuntimeNumericValue= double;
 
@@ -23,6 +24,7 @@ enum TokenType : uint8_t {
   LEFT_BRACE, 
   RIGHT_BRACE,
   COMMA, 
+  COLON,
   DOT, 
   MINUS, 
   PLUS, 
@@ -39,6 +41,10 @@ enum TokenType : uint8_t {
   GREATER_EQUAL,
   LESS, 
   LESS_EQUAL,
+  MINUS_MINUS,
+  MINUS_EQUAL,
+  PLUS_PLUS,
+  PLUS_EQUAL,
 
   // Literals.
   IDENTIFIER, 
@@ -47,7 +53,10 @@ enum TokenType : uint8_t {
 
   // Keywords.
   AND, 
+  CASE,
   CLASS, 
+  CONST,
+  DEFAULT,
   ELSE, 
   FALSE, 
   FN, 
@@ -57,6 +66,7 @@ enum TokenType : uint8_t {
   OR,
   RETURN, 
   SUPER, 
+  SWITCH,
   THIS, 
   TRUE, 
   VAR, 
@@ -80,9 +90,7 @@ using typeRuntimeValue =
     // Interpreter fields.
     std::shared_ptr<Invokable>, 
     std::shared_ptr<ClassInstance>,
-    std::string,
-    // VM & Compiler fields.
-    Obj*  // Pointer to the heap value.
+    std::string
   >;
 
 // Class "Invokable", for function and method.
@@ -178,7 +186,6 @@ using OpCodeType = uint8_t;
 using typeVMCodeArray = std::vector<uint8_t>;
 enum OpCode : OpCodeType {
   OP_CONSTANT,  // [OpCode, Constant Index (uint8_t)].
-  // OP_CONSTANT_LONG,
   OP_RETURN, 
   OP_NEGATE, 
   OP_ADD,
@@ -193,7 +200,7 @@ enum OpCode : OpCodeType {
   OP_GREATER,
   OP_LESS,
   OP_POP, 
-  OP_DEFINE_GLOBAL,
+  OP_DEFINE_GLOBAL,  // [OpCode, Global Slot (uint16_t)].
   OP_GET_GLOBAL,
   OP_SET_GLOBAL,
   OP_GET_LOCAL,
@@ -201,21 +208,122 @@ enum OpCode : OpCodeType {
   OP_JUMP_IF_FALSE,  // [OpCode, offset].
   OP_JUMP,
   OP_LOOP,
-  OP_CALL,
+  OP_CALL,  // [OpCode, argCount, Call Cache Index (uint16_t)].
   OP_CLOSURE,
   OP_GET_UPVALUE,
   OP_SET_UPVALUE,
   OP_CLOSE_UPVALUE,
   OP_CLASS,
   OP_SET_PROPERTY,
-  OP_GET_PROPERTY,
+  OP_GET_PROPERTY,  // [OpCode, Constant Index, Inline Cache Index (uint16_t)].
   OP_METHOD,
-  OP_INVOKE,
+  OP_INVOKE,  // [OpCode, Constant Index, argCount, Inline Cache Index (uint16_t)].
   OP_INHERIT,
   OP_GET_SUPER,
-  OP_SUPER_INVOKE,
+  OP_SUPER_INVOKE,  // [OpCode, Constant Index, argCount, Inline Cache Index (uint16_t)].
+  // Register mode, the operands "dst" / "lhs" / "rhs" address local slots of the current frame directly.
+  OP_MOVE,  // [OpCode, dst, src].
+  OP_LOAD_CONSTANT,  // [OpCode, dst, Constant Index].
+  OP_ADD_RR,  // [OpCode, dst, lhs, rhs].
+  OP_SUBTRACT_RR,
+  OP_MULTIPLY_RR,
+  OP_DIVIDE_RR,
+  OP_ADD_RK,  // [OpCode, dst, lhs, Constant Index].
+  OP_SUBTRACT_RK,
+  OP_MULTIPLY_RK,
+  OP_DIVIDE_RK,
+  OP_JUMP_IF_NOT_LESS_RR,  // [OpCode, lhs, rhs, offset].
+  OP_JUMP_IF_NOT_GREATER_RR,
+  OP_JUMP_IF_NOT_LESS_RK,  // [OpCode, lhs, Constant Index, offset].
+  OP_JUMP_IF_NOT_GREATER_RK,
+  // Superinstructions, each one replaces a frequently executed sequence (see "DEBUG_PROFILE_OPCODES").
+  OP_ADD_LOCAL_LOCAL,  // [OpCode, local, local], GET_LOCAL; GET_LOCAL; ADD.
+  OP_ADD_LOCAL_CONSTANT,  // [OpCode, local, Constant Index], GET_LOCAL; CONSTANT; ADD.
+  OP_SUBTRACT_LOCAL_CONSTANT,
+  OP_LESS_LOCAL_CONSTANT,
+  OP_SET_LOCAL_POP,  // [OpCode, local], SET_LOCAL; POP.
+  OP_CALL_GLOBAL,  // [OpCode, Global Slot (uint16_t), Call Cache Index (uint16_t)], GET_GLOBAL; CALL (without arguments).
+  OP_POP_JUMP_IF_FALSE,  // [OpCode, offset], JUMP_IF_FALSE; POP.
+  // Quickened forms, the VM rewrites a generic instruction into one of these in place once it observed the operands, -
+  // and back into the generic one when a guard fails (see "VM::run").
+  OP_ADD_NUM,  // OP_ADD on two numbers.
+  OP_ADD_STR,  // OP_ADD on two strings.
+  OP_GET_GLOBAL_DEFINED,  // [OpCode, Global Slot (uint16_t)], OP_GET_GLOBAL on a slot that has been defined.
+  OP_TAIL_CALL,  // [OpCode, argCount, Call Cache Index (uint16_t)], OP_CALL in tail position, the callee takes over the frame of the caller.
+  // Counted "for" loops, the counter is incremented by the step and the loop jumps back to its body -
+  // while the counter is still less (greater) than the limit (see "Compiler::forStatement").
+  OP_FOR_LOOP_LESS_RR,  // [OpCode, counter, limit, step Constant Index, offset].
+  OP_FOR_LOOP_GREATER_RR,
+  OP_FOR_LOOP_LESS_RK,  // [OpCode, counter, limit Constant Index, step Constant Index, offset].
+  OP_FOR_LOOP_GREATER_RK,
+  // Read-modify-write, the target is resolved once, "operator" is "OP_ADD" or "OP_SUBTRACT" applied with the value on top of the stack, -
+  // the result replaces that value, or the old value of the target does with "COMPOUND_POSTFIX" set (see "Compiler::compoundAssignment").
+  OP_COMPOUND_LOCAL,  // [OpCode, local, operator].
+  OP_COMPOUND_UPVALUE,  // [OpCode, Upvalue Index, operator].
+  OP_COMPOUND_GLOBAL,  // [OpCode, Global Slot (uint16_t), operator].
+  OP_COMPOUND_PROPERTY,  // [OpCode, Constant Index, operator, Inline Cache Index (uint16_t)], the instance is under the value.
+  OP_GET_CAPTURED,  // [OpCode, Upvalue Index], OP_GET_UPVALUE on a variable copied into the closure (see "Compiler::captureByValue").
+  // Wide forms for big (mostly generated) code, the short forms stay the default encoding.
+  OP_CONSTANT_LONG,  // [OpCode, Constant Index (24-bit)], for the literals past the 8-bit range (see "Compiler::makeLiteral").
+  OP_JUMP_LONG,  // [OpCode, offset (32-bit)], picked by "ChunkOptimizer::relaxJumps" for the jumps out of the 16-bit range.
+  OP_JUMP_IF_FALSE_LONG,
+  OP_LOOP_LONG,
+  OP_WIDE,  // [OpCode, OpCode, slot / Upvalue / Constant Index (uint16_t), ...], prefixing a local, upvalue or named instruction, widens its first operand.
+  OP_INTRINSIC,  // [OpCode, Intrinsic], OP_CALL of a native global the compiler knows by name, the native is computed inline.
+  // "switch", pop the value and jump to the body of its case (see "SwitchTable").
+  OP_SWITCH_TABLE,  // [OpCode, Switch Table Index (uint16_t)], dense integer labels, indexed by the value.
+  OP_SWITCH_HASH,  // [OpCode, Switch Table Index (uint16_t)], any literal labels, hashed.
+  OP_TAIL_INVOKE,  // [OpCode, Constant Index, argCount, Inline Cache Index (uint16_t)], OP_INVOKE in tail position (see "OP_TAIL_CALL").
+  OP_TAIL_SUPER_INVOKE,  // [OpCode, Constant Index, argCount, Inline Cache Index (uint16_t)], OP_SUPER_INVOKE in tail position.
 };
 
+// The natives "OP_INTRINSIC" inlines, the math ones come first (see "mathIntrinsic").
+enum Intrinsic : OpCodeType {
+  INTRINSIC_SQRT,
+  INTRINSIC_FLOOR,
+  INTRINSIC_CEIL,
+  INTRINSIC_ABS,
+  INTRINSIC_MIN,
+  INTRINSIC_MAX,
+  INTRINSIC_POW,
+  INTRINSIC_SIN,
+  INTRINSIC_COS,
+  INTRINSIC_LOG,
+  INTRINSIC_EXP,
+  INTRINSIC_LEN,  // len(string), the length in bytes.
+  INTRINSIC_CHAR_CODE,  // charCode(string, index), the byte at the index, nil out of range.
+  INTRINSIC_TOTAL,
+};
+struct IntrinsicInfo {
+  std::string_view name;
+  uint8_t arity;
+};
+constexpr IntrinsicInfo INTRINSICS[INTRINSIC_TOTAL] = {
+  { "sqrt", 1 },
+  { "floor", 1 },
+  { "ceil", 1 },
+  { "abs", 1 },
+  { "min", 2 },
+  { "max", 2 },
+  { "pow", 2 },
+  { "sin", 1 },
+  { "cos", 1 },
+  { "log", 1 },
+  { "exp", 1 },
+  { "len", 1 },
+  { "charCode", 2 },
+};
+
+constexpr OpCodeType COMPOUND_POSTFIX = 0x80;  // Flag of the "operator" operand, for "i++" / "i--".
+
+// How "OP_CLOSURE" captures each upvalue, the first operand of the (kind, index) pairs following the function.
+enum CaptureKind : OpCodeType {
+  CAPTURE_UPVALUE,  // An upvalue of the enclosing closure.
+  CAPTURE_LOCAL,  // A local of the enclosing frame, shared through an "ObjUpvalue".
+  CAPTURE_LOCAL_VALUE,  // A local of the enclosing frame which is never assigned again, copied.
+};
+constexpr OpCodeType CAPTURE_WIDE = 0x80;  // Flag of the kind, the index is 16-bit.
+
 enum class VMResult : uint8_t {
   INTERPRET_OK,
   INTERPRET_COMPILE_ERROR,
@@ -231,6 +339,7 @@ enum class ObjType : uint8_t {
   OBJ_CLASS,
   OBJ_INSTANCE,
   OBJ_BOUND_METHOD,
+  OBJ_SHAPE,
 };
 
 enum class FunctionScope : uint8_t {
@@ -240,9 +349,9 @@ enum class FunctionScope : uint8_t {
   TYPE_INITIALIZER,
 };
 
-using typeRuntimeConstantArray = std::vector<typeRuntimeValue>;
-using typeVMStack = std::array<typeRuntimeValue, STACK_MAX>;
-template<typename T = typeRuntimeValue> 
+using typeVMConstantArray = std::vector<VMValue>;
+using typeVMStack = std::vector<VMValue>;  // Grows on demand, see "VM::reserveStack" and "ObjFunc::maxStackHeight".
+template<typename T = VMValue> 
 using typeVMStore = std::unordered_map<Obj*, T>;
 
 #endif
@@ -0,0 +1,165 @@
+#ifndef	_VALUE_H
+#define	_VALUE_H
+
+/**
+ * The value representation of the VM (NaN-boxing).
+ *
+ * Every VM value fits into 8 bytes and is trivially copyable. A double is saved as is, -
+ * other values are encoded into the unused payload bits of a quiet NaN. -
+ * Numbers which stay integral are saved as 32-bit integers (see "VMValue::number"), -
+ * the integer arithmetic promotes its result to a double on overflow.
+ *
+ *   ┌─┬───────────┬──┬─────────────────────────────────────────────────────┐
+ *   │S│ exponent  │QI│                      payload                        │
+ *   └─┴───────────┴──┴─────────────────────────────────────────────────────┘
+ *    0  11111111111 11 00...000000000000000000000000000000000000000000000 01  nil
+ *    0  11111111111 11 00...000000000000000000000000000000000000000000000 10  false
+ *    0  11111111111 11 00...000000000000000000000000000000000000000000000 11  true
+ *    0  11111111111 11 00...000000000000000000000000000000000000000000001 00  undefined (unassigned global slot)
+ *    0  11111111111 11 01 0000000000000000 ....  32-bit signed integer  ....  integer
+ *    0  11111111111 11 10 0000000000000000 ....  32-bit index  ............  bound method on the stack
+ *    1  11111111111 11 ...........  48-bit "Obj*" pointer  .................  object
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <variant>
+
+struct Obj;
+struct VMValue {
+  static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+  static constexpr uint64_t QNAN = 0x7ffc000000000000;
+  static constexpr uint64_t TAG_NIL = 1;
+  static constexpr uint64_t TAG_FALSE = 2;
+  static constexpr uint64_t TAG_TRUE = 3;
+  static constexpr uint64_t TAG_UNDEFINED = 4;  // Never visible to the user code.
+  static constexpr uint64_t TAG_INT = 0x0001000000000000;
+  static constexpr uint64_t TAG_STACK_BOUND = 0x0002000000000000;  // Never visible to the user code (see "VM::bindMethod").
+  static constexpr uint64_t TAG_MASK = 0x0003000000000000;
+  uint64_t bits;
+  constexpr VMValue() : bits(QNAN | TAG_NIL) {}
+  constexpr VMValue(std::monostate) : VMValue() {}
+  constexpr VMValue(bool b) : bits(QNAN | (b ? TAG_TRUE : TAG_FALSE)) {}
+  VMValue(double num) {
+    std::memcpy(&bits, &num, sizeof(double));
+  }
+  VMValue(Obj* obj) : bits(SIGN_BIT | QNAN | static_cast<uint64_t>(reinterpret_cast<uintptr_t>(obj))) {}
+  static constexpr VMValue integer(int32_t num) {
+    VMValue v;
+    v.bits = QNAN | TAG_INT | static_cast<uint32_t>(num);
+    return v;
+  }
+  /**
+   * Take the integer representation for a double which is integral and fits (except "-0").
+  */
+  static VMValue number(double num) {
+    if (num >= INT32_MIN && num <= INT32_MAX) {  // Also false for NaN.
+      const auto integral = static_cast<int32_t>(num);
+      if (integral == num && !(integral == 0 && std::signbit(num))) return integer(integral);
+    }
+    return num;
+  }
+  static constexpr VMValue stackBound(uint32_t idx) {
+    VMValue v;
+    v.bits = QNAN | TAG_STACK_BOUND | idx;
+    return v;
+  }
+  static constexpr VMValue undefined(void) {
+    VMValue v;
+    v.bits = QNAN | TAG_UNDEFINED;
+    return v;
+  }
+  bool isUndefined(void) const {
+    return bits == (QNAN | TAG_UNDEFINED);
+  }
+  bool isNil(void) const {
+    return bits == (QNAN | TAG_NIL);
+  }
+  bool isBool(void) const {
+    return (bits | 1) == (QNAN | TAG_TRUE);  // Both "false" and "true" share the same upper bits.
+  }
+  bool isInt(void) const {
+    return (bits & (SIGN_BIT | QNAN | TAG_MASK)) == (QNAN | TAG_INT);
+  }
+  bool isStackBound(void) const {
+    return (bits & (SIGN_BIT | QNAN | TAG_MASK)) == (QNAN | TAG_STACK_BOUND);
+  }
+  bool isDouble(void) const {
+    return (bits & QNAN) != QNAN;
+  }
+  bool isNumber(void) const {
+    return isDouble() || isInt();
+  }
+  bool isObj(void) const {
+    return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT);
+  }
+  bool asBool(void) const {
+    return bits == (QNAN | TAG_TRUE);
+  }
+  int32_t asInt(void) const {
+    return static_cast<int32_t>(static_cast<uint32_t>(bits));
+  }
+  uint32_t asStackBound(void) const {
+    return static_cast<uint32_t>(bits);
+  }
+  double asNumber(void) const {  // Either representation.
+    if (isInt()) return asInt();
+    double num;
+    std::memcpy(&num, &bits, sizeof(double));
+    return num;
+  }
+  Obj* asObj(void) const {
+    return reinterpret_cast<Obj*>(static_cast<uintptr_t>(bits & ~(SIGN_BIT | QNAN)));
+  }
+  friend bool operator==(const VMValue& a, const VMValue& b) {
+    if (a.isInt() && b.isInt()) return a.bits == b.bits;
+    if (a.isNumber() && b.isNumber()) return a.asNumber() == b.asNumber();  // Keep IEEE 754 semantics (NaN != NaN).
+    return a.bits == b.bits;
+  }
+};
+
+inline bool bothInts(const VMValue& a, const VMValue& b) {  // Checked with a single branch.
+  constexpr auto mask = VMValue::SIGN_BIT | VMValue::QNAN | VMValue::TAG_MASK;
+  constexpr auto tag = VMValue::QNAN | VMValue::TAG_INT;
+  return __builtin_expect((((a.bits ^ tag) | (b.bits ^ tag)) & mask) == 0, 1);
+}
+
+/**
+ * Arithmetic on numbers (the operands have been checked), with fast paths for two integers.
+ * An integer result which overflows 32 bits is computed again on doubles.
+*/
+inline VMValue numberAdd(const VMValue& a, const VMValue& b) {
+  int32_t result;
+  if (bothInts(a, b) && !__builtin_add_overflow(a.asInt(), b.asInt(), &result)) [[likely]] return VMValue::integer(result);
+  return a.asNumber() + b.asNumber();
+}
+inline VMValue numberSubtract(const VMValue& a, const VMValue& b) {
+  int32_t result;
+  if (bothInts(a, b) && !__builtin_sub_overflow(a.asInt(), b.asInt(), &result)) [[likely]] return VMValue::integer(result);
+  return a.asNumber() - b.asNumber();
+}
+inline VMValue numberMultiply(const VMValue& a, const VMValue& b) {
+  int32_t result;
+  if (bothInts(a, b) && !__builtin_mul_overflow(a.asInt(), b.asInt(), &result)) [[likely]] {
+    if (result != 0 || (a.asInt() >= 0 && b.asInt() >= 0)) return VMValue::integer(result);  // Zero times a negative is "-0".
+  }
+  return a.asNumber() * b.asNumber();
+}
+inline VMValue numberDivide(const VMValue& a, const VMValue& b) {
+  return a.asNumber() / b.asNumber();
+}
+inline VMValue numberNegate(const VMValue& a) {
+  if (a.isInt() && a.asInt() != 0 && a.asInt() != INT32_MIN) return VMValue::integer(-a.asInt());  // The negated zero is "-0".
+  return -a.asNumber();
+}
+inline bool numberLess(const VMValue& a, const VMValue& b) {
+  if (bothInts(a, b)) [[likely]] return a.asInt() < b.asInt();
+  return a.asNumber() < b.asNumber();
+}
+inline bool numberGreater(const VMValue& a, const VMValue& b) {
+  if (bothInts(a, b)) [[likely]] return a.asInt() > b.asInt();
+  return a.asNumber() > b.asNumber();
+}
+
+#endif
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include "./verifier.h"
+
+void ChunkVerifier::fail(size_t offset, const std::string& msg) const {
+  const auto name = function->name != nullptr ? function->name->str : "script";
+  throw VMError { chunk.getLine(std::min(offset, chunk.code.size() - 1)), "invalid byte code in " + name + "(), " + msg + "." };
+}
+
+void ChunkVerifier::checkConstant(size_t offset, size_t idx) const {
+  if (idx >= chunk.constants.size()) fail(offset, "constant index out of range");
+}
+
+void ChunkVerifier::checkName(size_t offset, size_t idx) const {
+  checkConstant(offset, idx);
+  if (!isObjType(chunk.constants[idx], ObjType::OBJ_STRING)) fail(offset, "name constant is not a string");
+}
+
+void ChunkVerifier::checkCallCache(size_t offset, size_t idx) const {
+  if (idx >= chunk.callCaches.size()) fail(offset, "call cache index out of range");
+}
+
+void ChunkVerifier::checkSlot(size_t offset, size_t slot, size_t height) const {
+  if (slot >= height) fail(offset, "local slot out of range");
+}
+
+/**
+ * Return the size of the instruction at "offset", the ones running past the end of the code are rejected.
+*/
+size_t ChunkVerifier::decode(size_t offset) const {
+  const auto op = chunk.code[offset];
+  if (op == OpCode::OP_CLOSURE) {
+    if (offset + 1 >= chunk.code.size()) fail(offset, "truncated instruction");
+    checkConstant(offset, operand(offset));
+    if (!isObjType(chunk.constants[operand(offset)], ObjType::OBJ_FUNCTION)) fail(offset, "closure constant is not a function");
+  }
+  if (op == OpCode::OP_WIDE) {
+    if (offset + 3 >= chunk.code.size()) fail(offset, "truncated instruction");
+    switch (chunk.code[offset + 1]) {
+      case OpCode::OP_GET_LOCAL:
+      case OpCode::OP_SET_LOCAL:
+      case OpCode::OP_COMPOUND_LOCAL:
+      case OpCode::OP_GET_UPVALUE:
+      case OpCode::OP_SET_UPVALUE:
+      case OpCode::OP_GET_CAPTURED:
+      case OpCode::OP_COMPOUND_UPVALUE: break;
+      default: if (!Chunk::isNamed(chunk.code[offset + 1])) fail(offset, "invalid wide instruction");
+    }
+    if (chunk.code[offset + 1] == OpCode::OP_CLOSURE) {
+      checkConstant(offset, shortOperand(offset, 1));
+      if (!isObjType(chunk.constants[shortOperand(offset, 1)], ObjType::OBJ_FUNCTION)) fail(offset, "closure constant is not a function");
+    }
+  }
+  const auto size = chunk.instructionSize(offset);
+  if (offset + size > chunk.code.size()) fail(offset, "truncated instruction");
+  return size;
+}
+
+/**
+ * Check the operands of the instruction at "offset" which runs with "height" values on the stack, -
+ * and return how many values it pops and pushes.
+*/
+ChunkVerifier::StackEffect ChunkVerifier::checkInstruction(size_t offset, size_t height) const {
+  const auto op = chunk.code[offset];
+  switch (op) {
+    case OpCode::OP_NIL:
+    case OpCode::OP_TRUE:
+    case OpCode::OP_FALSE: return { 0, 1 };
+    case OpCode::OP_CONSTANT: {
+      checkConstant(offset, operand(offset));
+      return { 0, 1 };
+    }
+    case OpCode::OP_CONSTANT_LONG: {
+      checkConstant(offset, operand(offset) << 16 | shortOperand(offset, 1));
+      return { 0, 1 };
+    }
+    case OpCode::OP_NEGATE:
+    case OpCode::OP_NOT: return { 1, 1 };
+    case OpCode::OP_ADD:
+    case OpCode::OP_SUBTRACT:
+    case OpCode::OP_MULTIPLY:
+    case OpCode::OP_DIVIDE:
+    case OpCode::OP_EQUAL:
+    case OpCode::OP_GREATER:
+    case OpCode::OP_LESS:
+    case OpCode::OP_ADD_NUM:
+    case OpCode::OP_ADD_STR: return { 2, 1 };
+    case OpCode::OP_RETURN:
+    case OpCode::OP_POP:
+    case OpCode::OP_CLOSE_UPVALUE: return { 1, 0 };
+    case OpCode::OP_DEFINE_GLOBAL:
+    case OpCode::OP_GET_GLOBAL:
+    case OpCode::OP_GET_GLOBAL_DEFINED:
+    case OpCode::OP_SET_GLOBAL:
+    case OpCode::OP_CALL_GLOBAL: {
+      if (shortOperand(offset) >= globalCount) fail(offset, "global slot out of range");
+      if (op == OpCode::OP_CALL_GLOBAL) checkCallCache(offset, shortOperand(offset, 2));
+      if (op == OpCode::OP_DEFINE_GLOBAL) return { 1, 0 };
+      return op == OpCode::OP_SET_GLOBAL ? StackEffect { 1, 1 } : StackEffect { 0, 1 };
+    }
+    case OpCode::OP_GET_LOCAL: {
+      checkSlot(offset, operand(offset), height);
+      return { 0, 1 };
+    }
+    case OpCode::OP_SET_LOCAL:
+    case OpCode::OP_SET_LOCAL_POP: {
+      checkSlot(offset, operand(offset), height);
+      return op == OpCode::OP_SET_LOCAL ? StackEffect { 1, 1 } : StackEffect { 1, 0 };
+    }
+    case OpCode::OP_JUMP_IF_FALSE:
+    case OpCode::OP_JUMP_IF_FALSE_LONG: return { 1, 1 };
+    case OpCode::OP_POP_JUMP_IF_FALSE: return { 1, 0 };
+    case OpCode::OP_JUMP:
+    case OpCode::OP_LOOP:
+    case OpCode::OP_JUMP_LONG:
+    case OpCode::OP_LOOP_LONG: return { 0, 0 };
+    case OpCode::OP_WIDE: {  // The same as the prefixed instruction, with a 16-bit slot, upvalue or constant index.
+      const auto prefixed = operand(offset);
+      const auto index = shortOperand(offset, 1);
+      if (Chunk::isNamed(prefixed)) return checkNamed(offset, prefixed, index, offset + 3, height);
+      if (prefixed == OpCode::OP_GET_LOCAL || prefixed == OpCode::OP_SET_LOCAL || prefixed == OpCode::OP_COMPOUND_LOCAL) {
+        checkSlot(offset, index, height);
+      } else if (index >= function->upvalueCount) {
+        fail(offset, "upvalue index out of range");
+      }
+      if (prefixed == OpCode::OP_COMPOUND_LOCAL || prefixed == OpCode::OP_COMPOUND_UPVALUE) {
+        const auto arithmetic = operand(offset, 3) & ~COMPOUND_POSTFIX;
+        if (arithmetic != OpCode::OP_ADD && arithmetic != OpCode::OP_SUBTRACT) fail(offset, "invalid compound operator");
+      }
+      return prefixed == OpCode::OP_GET_LOCAL || prefixed == OpCode::OP_GET_UPVALUE || prefixed == OpCode::OP_GET_CAPTURED ?
+        StackEffect { 0, 1 } : StackEffect { 1, 1 };
+    }
+    case OpCode::OP_CALL:
+    case OpCode::OP_TAIL_CALL: {
+      checkCallCache(offset, shortOperand(offset, 1));
+      return { operand(offset) + 1, 1 };  // The callee and the arguments.
+    }
+    case OpCode::OP_SWITCH_TABLE:
+    case OpCode::OP_SWITCH_HASH: {
+      if (shortOperand(offset) >= chunk.switchTables.size()) fail(offset, "switch table index out of range");
+      return { 1, 0 };
+    }
+    case OpCode::OP_INTRINSIC: {
+      if (operand(offset) >= INTRINSIC_TOTAL) fail(offset, "unknown intrinsic");
+      return { INTRINSICS[operand(offset)].arity + size_t { 1 }, 1 };
+    }
+    case OpCode::OP_GET_UPVALUE:
+    case OpCode::OP_SET_UPVALUE:
+    case OpCode::OP_GET_CAPTURED: {
+      if (operand(offset) >= function->upvalueCount) fail(offset, "upvalue index out of range");
+      return op == OpCode::OP_SET_UPVALUE ? StackEffect { 1, 1 } : StackEffect { 0, 1 };
+    }
+    case OpCode::OP_CLOSURE:
+    case OpCode::OP_CLASS:
+    case OpCode::OP_GET_PROPERTY:
+    case OpCode::OP_SET_PROPERTY:
+    case OpCode::OP_COMPOUND_PROPERTY:
+    case OpCode::OP_METHOD:
+    case OpCode::OP_INVOKE:
+    case OpCode::OP_TAIL_INVOKE:
+    case OpCode::OP_GET_SUPER:
+    case OpCode::OP_SUPER_INVOKE:
+    case OpCode::OP_TAIL_SUPER_INVOKE: return checkNamed(offset, op, operand(offset), offset + 1, height);
+    case OpCode::OP_INHERIT: return { 2, 1 };
+    case OpCode::OP_MOVE: {
+      checkSlot(offset, operand(offset), height);
+      checkSlot(offset, operand(offset, 1), height);
+      return { 0, 0 };
+    }
+    case OpCode::OP_LOAD_CONSTANT: {
+      checkSlot(offset, operand(offset), height);
+      checkConstant(offset, operand(offset, 1));
+      return { 0, 0 };
+    }
+    case OpCode::OP_ADD_RR:
+    case OpCode::OP_SUBTRACT_RR:
+    case OpCode::OP_MULTIPLY_RR:
+    case OpCode::OP_DIVIDE_RR:
+    case OpCode::OP_ADD_RK:
+    case OpCode::OP_SUBTRACT_RK:
+    case OpCode::OP_MULTIPLY_RK:
+    case OpCode::OP_DIVIDE_RK: {
+      const auto constantOperand = op >= OpCode::OP_ADD_RK;
+      checkSlot(offset, operand(offset), height);
+      checkSlot(offset, operand(offset, 1), height);
+      constantOperand ? checkConstant(offset, operand(offset, 2)) : checkSlot(offset, operand(offset, 2), height);
+      return { 0, 0 };
+    }
+    case OpCode::OP_JUMP_IF_NOT_LESS_RR:
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RR:
+    case OpCode::OP_JUMP_IF_NOT_LESS_RK:
+    case OpCode::OP_JUMP_IF_NOT_GREATER_RK: {
+      const auto constantOperand = op >= OpCode::OP_JUMP_IF_NOT_LESS_RK;
+      checkSlot(offset, operand(offset), height);
+      constantOperand ? checkConstant(offset, operand(offset, 1)) : checkSlot(offset, operand(offset, 1), height);
+      return { 0, 0 };
+    }
+    case OpCode::OP_FOR_LOOP_LESS_RR:
+    case OpCode::OP_FOR_LOOP_GREATER_RR:
+    case OpCode::OP_FOR_LOOP_LESS_RK:
+    case OpCode::OP_FOR_LOOP_GREATER_RK: {
+      const auto constantLimit = op >= OpCode::OP_FOR_LOOP_LESS_RK;
+      checkSlot(offset, operand(offset), height);
+      constantLimit ? checkConstant(offset, operand(offset, 1)) : checkSlot(offset, operand(offset, 1), height);
+      checkConstant(offset, operand(offset, 2));
+      return { 0, 0 };
+    }
+    case OpCode::OP_ADD_LOCAL_LOCAL: {
+      checkSlot(offset, operand(offset), height);
+      checkSlot(offset, operand(offset, 1), height);
+      return { 0, 1 };
+    }
+    case OpCode::OP_ADD_LOCAL_CONSTANT:
+    case OpCode::OP_SUBTRACT_LOCAL_CONSTANT:
+    case OpCode::OP_LESS_LOCAL_CONSTANT: {
+      checkSlot(offset, operand(offset), height);
+      checkConstant(offset, operand(offset, 1));
+      return { 0, 1 };
+    }
+    case OpCode::OP_COMPOUND_LOCAL:
+    case OpCode::OP_COMPOUND_UPVALUE:
+    case OpCode::OP_COMPOUND_GLOBAL: {
+      size_t operatorIdx = 1;
+      if (op == OpCode::OP_COMPOUND_LOCAL) {
+        checkSlot(offset, operand(offset), height);
+      } else if (op == OpCode::OP_COMPOUND_UPVALUE) {
+        if (operand(offset) >= function->upvalueCount) fail(offset, "upvalue index out of range");
+      } else {
+        if (shortOperand(offset) >= globalCount) fail(offset, "global slot out of range");
+        operatorIdx = 2;
+      }
+      const auto arithmetic = operand(offset, operatorIdx) & ~COMPOUND_POSTFIX;
+      if (arithmetic != OpCode::OP_ADD && arithmetic != OpCode::OP_SUBTRACT) fail(offset, "invalid compound operator");
+      return { 1, 1 };
+    }
+    default: fail(offset, "unknown opcode");
+  }
+}
+
+/**
+ * Check an instruction whose first operand is the name or function constant "idx" (8-bit, or 16-bit after "OP_WIDE"), -
+ * the operands following it are read from "rest" as if it were the offset of the instruction.
+*/
+ChunkVerifier::StackEffect ChunkVerifier::checkNamed(size_t offset, OpCodeType op, size_t idx, size_t rest, size_t height) const {
+  if (op == OpCode::OP_CLOSURE) {
+    const auto closed = retrieveObjFunc(chunk.constants[idx].asObj());  // Checked by "decode".
+    for (size_t i = 0, pos = 0; i < closed->upvalueCount; i++) {
+      const auto kind = operand(rest, pos) & ~CAPTURE_WIDE;
+      const auto index = (operand(rest, pos) & CAPTURE_WIDE) ? shortOperand(rest, pos + 1) : operand(rest, pos + 1);
+      pos += (operand(rest, pos) & CAPTURE_WIDE) ? 3 : 2;
+      if (kind == CAPTURE_LOCAL || kind == CAPTURE_LOCAL_VALUE) {
+        checkSlot(offset, index, height + 1);  // The closure is pushed before capturing, a local function captures itself.
+      } else if (kind != CAPTURE_UPVALUE) {
+        fail(offset, "unknown capture kind");
+      } else if (index >= function->upvalueCount) {
+        fail(offset, "upvalue index out of range");
+      }
+    }
+    return { 0, 1 };
+  }
+  checkName(offset, idx);
+  switch (op) {
+    case OpCode::OP_CLASS: return { 0, 1 };
+    case OpCode::OP_SET_PROPERTY:
+    case OpCode::OP_METHOD:
+    case OpCode::OP_GET_SUPER: return { 2, 1 };
+    case OpCode::OP_COMPOUND_PROPERTY: {
+      if (shortOperand(rest, 1) >= chunk.caches.size()) fail(offset, "inline cache index out of range");
+      const auto arithmetic = operand(rest) & ~COMPOUND_POSTFIX;
+      if (arithmetic != OpCode::OP_ADD && arithmetic != OpCode::OP_SUBTRACT) fail(offset, "invalid compound operator");
+      return { 2, 1 };  // The value and the instance.
+    }
+    default: {
+      const auto cacheIdx = shortOperand(rest, op == OpCode::OP_GET_PROPERTY ? 0 : 1);
+      if (cacheIdx >= chunk.caches.size()) fail(offset, "inline cache index out of range");
+      if (op == OpCode::OP_GET_PROPERTY) return { 1, 1 };
+      const auto isSuper = op == OpCode::OP_SUPER_INVOKE || op == OpCode::OP_TAIL_SUPER_INVOKE;
+      return { operand(rest) + (isSuper ? 2 : 1), 1 };  // The receiver (and the superclass) and the arguments.
+    }
+  }
+}
+
+size_t ChunkVerifier::verify(void) {
+  const auto& code = chunk.code;
+  if (code.empty()) fail(0, "empty code");
+  for (size_t offset = 0; offset < code.size(); offset += decode(offset)) {
+    isInstruction[offset] = true;
+  }
+  // The stack height before each instruction (-1 for not reached yet), a frame starts with the callee and the arguments.
+  std::vector<int64_t> heights(code.size(), -1);
+  std::vector<size_t> worklist { 0 };
+  heights[0] = function->arity + 1;
+  size_t maxHeight = heights[0];
+  const auto reach = [&](size_t from, size_t target, size_t height) {
+    if (target >= code.size() || !isInstruction[target]) fail(from, "control flow leaves the instruction stream");
+    if (heights[target] == -1) {
+      heights[target] = height;
+      worklist.push_back(target);
+    } else if (heights[target] != static_cast<int64_t>(height)) {
+      fail(target, "inconsistent stack height");
+    }
+  };
+  while (!worklist.empty()) {
+    const auto offset = worklist.back();
+    worklist.pop_back();
+    const auto height = static_cast<size_t>(heights[offset]);
+    const auto effect = checkInstruction(offset, height);
+    if (effect.pops > height) fail(offset, "stack underflow");
+    const auto next = height - effect.pops + effect.pushes;
+    maxHeight = std::max(maxHeight, next);
+    const auto op = code[offset];
+    if (op == OpCode::OP_RETURN) continue;
+    const auto end = offset + chunk.instructionSize(offset);
+    const auto direction = Chunk::jumpDirection(op);
+    if (direction != 0) {
+      const auto jump = chunk.jumpOffset(offset);
+      if (direction < 0 && jump > end) fail(offset, "control flow leaves the instruction stream");
+      reach(offset, direction > 0 ? end + jump : end - jump, next);
+    }
+    if (op == OpCode::OP_SWITCH_TABLE || op == OpCode::OP_SWITCH_HASH) {  // Never falls through, the default target is the end at least.
+      chunk.switchTables[shortOperand(offset)].forEachTarget([&](size_t target) { reach(offset, target, next); });
+      continue;
+    }
+    if (op != OpCode::OP_JUMP && op != OpCode::OP_LOOP && op != OpCode::OP_JUMP_LONG && op != OpCode::OP_LOOP_LONG) {
+      reach(offset, end, next);
+    }
+  }
+  return maxHeight;
+}
+
+void ChunkVerifier::verify(ObjFunc* function, size_t globalCount) {
+  function->maxStackHeight = ChunkVerifier { function, globalCount }.verify();
+}
@@ -0,0 +1,57 @@
+#ifndef	_VERIFIER_H
+#define	_VERIFIER_H
+
+/**
+ * Byte code verification, it runs on the final code of each compiled function (after the optimizer passes).
+ *
+ * The verifier decodes every instruction and checks its operands (constant indices and their types, -
+ * inline and call caches, global slots, upvalues), and that every jump lands on an instruction.
+ * Then it walks all the paths of the code, tracking the stack height (counted from slot zero of the frame), -
+ * which must never go below zero or differ between two paths reaching the same instruction, -
+ * and no path may run past the end of the code.
+ * The highest height seen is saved as "ObjFunc::maxStackHeight", -
+ * so the VM checks the stack capacity once per call instead of on each push.
+ *
+ * A failure means the compiler (or an optimizer pass) produced broken code, it throws a "VMError".
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "./chunk.h"
+#include "./object.h"
+#include "./error.h"
+
+struct ChunkVerifier {
+  struct StackEffect {
+    size_t pops;
+    size_t pushes;
+  };
+  const ObjFunc* function;
+  const Chunk& chunk;
+  size_t globalCount;
+  std::vector<bool> isInstruction;  // Whether an instruction starts at each offset.
+  ChunkVerifier(const ObjFunc* function, size_t globalCount) :
+    function(function),
+    chunk(function->chunk),
+    globalCount(globalCount),
+    isInstruction(function->chunk.code.size() + 1, false) {}
+  [[noreturn]] void fail(size_t offset, const std::string& msg) const;
+  size_t operand(size_t offset, size_t n = 0) const {
+    return chunk.code[offset + 1 + n];
+  }
+  size_t shortOperand(size_t offset, size_t n = 0) const {
+    return chunk.code[offset + 1 + n] << 8 | chunk.code[offset + 2 + n];
+  }
+  void checkConstant(size_t offset, size_t idx) const;
+  void checkName(size_t offset, size_t idx) const;
+  void checkSlot(size_t offset, size_t slot, size_t height) const;
+  void checkCallCache(size_t offset, size_t idx) const;
+  size_t decode(size_t offset) const;
+  StackEffect checkInstruction(size_t offset, size_t height) const;
+  StackEffect checkNamed(size_t offset, OpCodeType op, size_t idx, size_t rest, size_t height) const;
+  size_t verify(void);  // Return the maximum stack height.
+  static void verify(ObjFunc*, size_t globalCount);
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include "./common.h"
 #include "./vm.h"
@@ -7,50 +8,54 @@
 
 void VM::initVM(ObjFunc* function) {
   mem->setVM(this);
+  push(function);  // Save the top-level function onto the stack, which also roots it for GC.
   initString = internedConstants.add(INITIALIZER_NAME);
+  rootShape = mem->makeObj<ObjShape>();
+  for (uint32_t i = STACK_BOUND_METHODS_MAX; i >= 1; i--) {
+    freeStackBoundMethods.push_back(i - 1);
+  }
   defineNative("print", nativePrint, 1);
   defineNative("clock", nativeClock, 0);
-  push(function);  // Save the top-level function onto the stack.
+  for (OpCodeType id = 0; id < INTRINSIC_TOTAL; id++) {
+    intrinsics[id] = defineNative(INTRINSICS[id].name, INTRINSIC_NATIVES[id], INTRINSICS[id].arity);
+  }
   call(function, 0);  // Add a frame for the calling function.
 }
 
 void VM::freeVM(void) {
   initString = nullptr;
+  rootShape = nullptr;
+  intrinsics.fill(nullptr);
   mem->free();
 } 
 
-void VM::defineNative(const char* name, ObjNative::typeNativeFn function, uint8_t arity) {
+Obj* VM::defineNative(std::string_view name, ObjNative::typeNativeFn function, uint8_t arity) {
   const auto nativeName = internedConstants.add(name);
-  globals[nativeName] = nullptr;  // For comforting GC.
-  globals[nativeName] = mem->makeObj<ObjNative>(function, arity, nativeName);
+  const auto slot = globals.resolve(nativeName);  // The name is reachable from the slot table, for comforting GC.
+  const auto native = mem->makeObj<ObjNative>(function, arity, nativeName);
+  globals.values[slot] = native;
+  return native;
 }
 
-ObjUpvalue* VM::captureUpvalue(typeRuntimeValue* local) {
-  ObjUpvalue* prevUpvalue = nullptr;
-  auto upvalue = openUpvalues;
-  while (upvalue != nullptr && upvalue->location > local) {  // Searching from stack top to bottom.
-    prevUpvalue = upvalue;
-    upvalue = upvalue->nextValue;
-  }
-  if (upvalue != nullptr && upvalue->location == local) {
-    return upvalue;
-  }
-  const auto createdUpvalue = mem->makeObj<ObjUpvalue>(local, upvalue);
-  if (prevUpvalue == nullptr) {
-    openUpvalues = createdUpvalue;  // Empty list.
-  } else {
-    prevUpvalue->nextValue = createdUpvalue;  // Insert into the list at a right position.
+ObjUpvalue* VM::captureUpvalue(VMValue* local) {
+  const auto offset = static_cast<size_t>(local - stack.data());
+  if (openUpvalues[offset] == nullptr) {
+    openUpvalues[offset] = mem->makeObj<ObjUpvalue>(local);
+    openUpvalueTop = std::max(openUpvalueTop, offset + 1);
   }
-  return createdUpvalue;
+  return openUpvalues[offset];
 }
 
-void VM::closeUpvalues(typeRuntimeValue* last) {
-  while (openUpvalues != nullptr && openUpvalues->location >= last) {
-    auto upvalue = openUpvalues;
-    upvalue->closed = *upvalue->location;  // Save closed upvalue onto the heap "ObjUpvalue" object.
-    upvalue->location = &upvalue->closed;
-    openUpvalues = upvalue->nextValue;
+void VM::closeUpvalues(VMValue* last) {
+  const auto first = static_cast<size_t>(last - stack.data());
+  for (auto offset = first; offset < openUpvalueTop; offset++) {
+    if (const auto upvalue = openUpvalues[offset]; upvalue != nullptr) {
+      upvalue->closed = materialize(*upvalue->location);  // Save closed upvalue onto the heap "ObjUpvalue" object.
+      upvalue->location = &upvalue->closed;
+      openUpvalues[offset] = nullptr;
+    }
   }
+  openUpvalueTop = std::min(openUpvalueTop, first);
 }
 
 void VM::call(Obj* obj, uint8_t argCount) {
@@ -61,32 +66,92 @@ void VM::call(Obj* obj, uint8_t argCount) {
   if (frameCount == FRAMES_MAX) {
     throwRuntimeError("stack overflow.");
   }
-  currentFrame = &frames[frameCount++];
-  currentFrame->frameEntity = obj;
-  currentFrame->ip = function->chunk.code.cbegin();
-  currentFrame->slots = stackTop - argCount - 1;
+  if (frameCount == frames.size()) {
+    frames.resize(std::min(frames.size() * 2, static_cast<size_t>(FRAMES_MAX)));
+  }
+  reserveStack(function->maxStackHeight - argCount - 1);  // The frame starts at the callee, which is already on the stack.
+  pushFrame(obj, function, argCount);
+}
+
+/**
+ * The generic path of a call site, a function or closure it called (after checking the arity) is cached, -
+ * so the following calls of the site skip the type dispatch and the checks.
+ * The callee is taken by value, the call may move the stack.
+*/
+void VM::resolveCall(VMValue callee, uint8_t argCount, CallCache& cache) {
+  callValue(callee, argCount);
+  if (isObjType(callee, ObjType::OBJ_FUNCTION) || isObjType(callee, ObjType::OBJ_CLOSURE)) {
+    cache = { callee.asObj(), retrieveObjFunc(callee.asObj()) };
+  }
+}
+
+/**
+ * Make sure there are at least "slots" unused slots above "stackTop". The stack is moved to a larger storage if not, -
+ * then everything pointing into the old one is rebased: "stackTop", the slots of the frames and the open upvalues.
+ * The cached "slots" of "VM::run" is reloaded from the current frame after each call.
+*/
+void VM::reserveStack(size_t slots) {
+  const auto used = static_cast<size_t>(stackTop - stack.begin());
+  if (used + slots <= stack.size()) return;
+  std::vector<size_t> frameOffsets;
+  frameOffsets.reserve(frameCount);
+  for (size_t i = 0; i < frameCount; i++) {
+    frameOffsets.push_back(frames[i].slots - stack.begin());
+  }
+  stack.resize(std::max(stack.size() * 2, used + slots));
+  stackTop = stack.begin() + used;
+  for (size_t i = 0; i < frameCount; i++) {
+    frames[i].slots = stack.begin() + frameOffsets[i];
+  }
+  openUpvalues.resize(stack.size(), nullptr);
+  for (size_t offset = 0; offset < openUpvalueTop; offset++) {
+    if (openUpvalues[offset] != nullptr) openUpvalues[offset]->location = stack.data() + offset;
+  }
 }
 
-void VM::callValue(typeRuntimeValue& callee, uint8_t argCount) {
-  if (std::holds_alternative<Obj*>(callee)) {
-    const auto calleeObj = std::get<Obj*>(callee);
+/**
+ * A tail call pushed a new frame, move its window (callee / receiver and arguments) down -
+ * onto the window of the calling frame, and let the new frame take over the slot of the caller.
+ * The upvalues captured from the caller are closed first, its locals are gone after this.
+*/
+void VM::replaceCallerFrame(void) {
+  auto& caller = frames[frameCount - 2];
+  const auto callerSlots = caller.slots;
+  closeUpvalues(&*callerSlots);
+  stackTop = std::copy(currentFrame->slots, stackTop, callerSlots);
+  caller = *currentFrame;
+  caller.slots = callerSlots;
+  frameCount--;
+  currentFrame = &caller;
+}
+
+void VM::callValue(const VMValue& callee, uint8_t argCount) {
+  if (callee.isObj()) {
+    const auto calleeObj = callee.asObj();
     switch (calleeObj->type) {
       case ObjType::OBJ_NATIVE: {
         const auto nativeFunc = calleeObj->cast<ObjNative>();;
         if (nativeFunc->arity != argCount) {
           throwRuntimeError("incorrect number of arguments passed to native function '" + nativeFunc->name->cast<ObjString>()->str + "'.");
         }
-        const auto result = nativeFunc->function(argCount, stackTop - argCount);
+        for (auto arg = stackTop - argCount; arg < stackTop; arg++) {
+          *arg = materialize(*arg);
+        }
+        VMValue result;
+        try {
+          result = nativeFunc->function(argCount, stackTop - argCount);
+        } catch (const NativeError& err) {
+          throwRuntimeError(err.msg);
+        }
         stackTop -= argCount + 1;
         push(result);
         return;
       }
       case ObjType::OBJ_CLASS: {
         const auto klass = calleeObj->cast<ObjClass>();
-        *(stackTop - argCount - 1) = mem->makeObj<ObjInstance>(klass);  // Replace the class object being called to its instance.
-        decltype(klass->methods)::iterator initializer;
-        if ((initializer = klass->methods.find(initString)) != klass->methods.end()) {
-          call(initializer->second, argCount);
+        *(stackTop - argCount - 1) = mem->makeObj<ObjInstance>(klass, rootShape);  // Replace the class object being called to its instance.
+        if (klass->initializer != nullptr) {
+          call(klass->initializer, argCount);
         } else if (argCount > 0) {
           throwRuntimeError("expected 0 arguments but got " + std::to_string(argCount) + ".");
         }
@@ -121,39 +186,112 @@ void VM::callValue(typeRuntimeValue& callee, uint8_t argCount) {
       }
       default: ;
     }
+  } else if (callee.isStackBound()) {
+    const auto& bound = stackBoundMethods[callee.asStackBound()];
+    *(stackTop - argCount - 1) = bound.receiver;  // The same as "OBJ_BOUND_METHOD".
+    call(bound.method, argCount);
+    return;
   }
   throwRuntimeError("can only call functions and classes.");
 }
 
+VMValue VM::concatenate(const VMValue& x, const VMValue& y) {
+  if (isObjStringValue(x) || isObjStringValue(y)) {
+    const auto str = stringifyVMValue(materialize(x)) + stringifyVMValue(materialize(y));
+    return internedConstants.add(str);
+  }
+  throwRuntimeError("invalid operand types for \"+\" operator.");
+}
+
 void VM::defineMethod(Obj* name) {
-  const auto method = peekOfType<Obj*>();
-  auto klass = peekOfType<Obj*>(1)->cast<ObjClass>();
-  klass->methods[name] = method;
+  const auto method = peek().asObj();
+  auto klass = peek(1).asObj()->cast<ObjClass>();
+  klass->setMethod(name, method);
+  if (name == initString) klass->initializer = method;
+  klass->version++;
   pop();  // Pop the method function (or closure).
 }
 
+Obj* VM::findMethod(ObjClass* klass, Obj* name) {
+  const auto method = klass->findMethod(name);
+  if (method == nullptr) {
+    throwRuntimeError("undefined property '" + name->cast<ObjString>()->str + "'.");
+  }
+  return method;
+}
+
 /**
  * Bind calling method to its class instance.
+ * The bound method takes a slot of "stackBoundMethods" instead of a heap object, -
+ * as it is mostly called right away (through a local or an argument) and dropped. -
+ * Such a value is only allowed on the stack, the slot is taken back once no stack value refers to it.
 */
-void VM::bindMethod(ObjClass* klass, Obj* name) {
-  const auto& method =klass->methods.find(name);
-  if (method == klass->methods.end()) {
-    throwRuntimeError("undefined property '" + name->cast<ObjString>()->str + "'.");
+void VM::bindMethod(Obj* method) {
+  if (freeStackBoundMethods.empty() && heapBindCountdown == 0) {
+    reclaimStackBoundMethods();
+    if (freeStackBoundMethods.empty()) heapBindCountdown = STACK_BOUND_METHODS_MAX;  // All in use, don't rescan the stack on every bind.
   }
-  auto bound = mem->makeObj<ObjBoundMethod>(peek(0), method->second);
+  if (!freeStackBoundMethods.empty()) {
+    const auto idx = freeStackBoundMethods.back();
+    freeStackBoundMethods.pop_back();
+    stackBoundMethods[idx] = { peek(0), method, nullptr };
+    *top() = VMValue::stackBound(idx);
+    return;
+  }
+  heapBindCountdown--;
+  auto bound = mem->makeObj<ObjBoundMethod>(peek(0), method);
   pop();
   push(bound);  // Save the decorated method onto the stack.
 }
 
-void VM::invokeFromClass(ObjClass* klass, Obj* name, uint8_t argCount) {
-  const auto& method =klass->methods.find(name); 
-  if (method == klass->methods.end()) {
-    throwRuntimeError("undefined property '" + name->cast<ObjString>()->str + "'.");
+void VM::reclaimStackBoundMethods(void) {
+  std::array<bool, STACK_BOUND_METHODS_MAX> inUse {};
+  for (auto slot = stack.cbegin(); slot < stackTop; slot++) {
+    if (slot->isStackBound()) inUse[slot->asStackBound()] = true;
+  }
+  for (uint32_t i = 0; i < STACK_BOUND_METHODS_MAX; i++) {
+    if (!inUse[i]) freeStackBoundMethods.push_back(i);
   }
-  call(method->second, argCount);
 }
 
-void VM::invoke(Obj* name, uint8_t argCount) {
+VMValue VM::materializeStackBound(uint32_t idx) {
+  auto& bound = stackBoundMethods[idx];
+  if (bound.materialized == nullptr) {
+    bound.materialized = mem->makeObj<ObjBoundMethod>(bound.receiver, bound.method);  // The stack value keeps the slot marked.
+  }
+  return bound.materialized;
+}
+
+void VM::bindMethod(ObjClass* klass, Obj* name) {
+  bindMethod(findMethod(klass, name));
+}
+
+/**
+ * Resolve the property "name" of a receiver (with "shape" being "nullptr" for looking up the methods only), -
+ * and record the result into the inline cache of the instruction.
+*/
+InlineCacheEntry VM::resolveProperty(InlineCache& cache, ObjClass* klass, ObjShape* shape, Obj* name) {
+  InlineCacheEntry resolved { klass, shape, klass->version, shape == nullptr ? ObjShape::NO_SLOT : shape->lookup(name), nullptr };
+  if (resolved.slot == ObjShape::NO_SLOT) {
+    resolved.method = findMethod(klass, name);  // Fields shadow methods.
+  }
+  if (cache.megamorphic) return resolved;
+  for (uint8_t i = 0; i < cache.count; i++) {
+    auto& entry = cache.entries[i];
+    if (entry.klass == klass && entry.shape == shape) {
+      entry = resolved;  // Refresh the entry invalidated by a class change.
+      return resolved;
+    }
+  }
+  if (cache.count < INLINE_CACHE_SIZE) {
+    cache.entries[cache.count++] = resolved;
+  } else {
+    cache.megamorphic = true;
+  }
+  return resolved;
+}
+
+void VM::invoke(Obj* name, uint8_t argCount, InlineCache& cache) {
   /**
                 ┌───────┐ name ┌────────┐
     (Slot 0) -> | class |─────>│ method │────────────┐
@@ -164,138 +302,431 @@ void VM::invoke(Obj* name, uint8_t argCount) {
           └──────┴──────0─────────────────────1──────2──────3
                         ┼        Slot 0       ┼ 
   */
-  Obj* receiverObj = nullptr;
-  if (!std::holds_alternative<Obj*>(peek(argCount)) 
-    || (receiverObj = std::get<Obj*>(peek(argCount)))->type != ObjType::OBJ_INSTANCE) {
+  const auto& receiver = peek(argCount);
+  if (!isObjType(receiver, ObjType::OBJ_INSTANCE)) {
     throwRuntimeError("only instances have methods.");
   }
-  auto instance = receiverObj->cast<ObjInstance>();
-  // Field access gose first.
-  const auto valIt = instance->fields.find(name);
-  if (valIt != instance->fields.end()) {
-    *(stackTop - argCount - 1) = valIt->second;
-    return callValue(valIt->second, argCount);
-  } else {
-    return invokeFromClass(instance->klass, name, argCount);
+  auto instance = receiver.asObj()->cast<ObjInstance>();
+  const auto resolved = lookupProperty(cache, instance->klass, instance->shape, name);
+  if (resolved.slot != ObjShape::NO_SLOT) {  // Field access gose first.
+    const auto field = instance->fields[resolved.slot];
+    *(stackTop - argCount - 1) = field;
+    return callValue(field, argCount);
   }
+  call(resolved.method, argCount);
 }
 
+ObjShape* VM::transitShape(ObjShape* shape, Obj* name) {
+  const auto it = shape->transitions.find(name);
+  if (it != shape->transitions.end()) {
+    return it->second;
+  }
+  const auto next = mem->makeObj<ObjShape>(shape, name);
+  shape->transitions[name] = next;
+  return next;
+}
+
+void VM::setField(ObjInstance* instance, Obj* name, const VMValue& v) {
+  const auto value = materialize(v);
+  const auto field = instance->findField(name);
+  if (field != nullptr) {
+    *field = value;
+    return;
+  }
+  instance->shape = transitShape(instance->shape, name);  // Adding a new field moves the instance to a child shape.
+  instance->fields.push_back(value);
+  auto klass = instance->klass;
+  if (klass->fieldCount < instance->fields.size() && klass->fieldCount < ObjClass::FIELD_COUNT_MAX) {
+    klass->fieldCount = instance->fields.size();
+  }
+}
+
+/**
+ * The dispatch loop keeps the hot frame state (ip, slot base and constant base) in locals, -
+ * they are written back to / reloaded from the current "CallFrame" only around calls and returns.
+ * With GCC or Clang, each handler jumps straight to the next one through a table of label addresses -
+ * (threaded code), otherwise it falls back to a portable "switch" loop.
+*/
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO
+#endif
+
+void VM::traceInstruction(typeVMCodeArray::const_iterator ip) {
+  printf("          ■ ");
+  for (auto it = stack.cbegin(); it < stackTop; it++) {
+    printf("[ ");
+    printValue(*it);
+    printf(" ] ");
+  }
+  printf("<-\n");
+  ChunkDebugger::disassembleInstruction(retrieveObjFunc(currentFrame->frameEntity)->chunk, ip);
+}
+
+/**
+ * The loop is instantiated twice, "run<true>" traces each instruction before running it (see "traceExecution"), -
+ * "run<false>" has no trace code at all.
+*/
+template <bool traced>
 VMResult VM::run(void) {
-  #define NUM_BINARY_OP(op) \
+  auto ip = currentFrame->ip;
+  auto slots = currentFrame->slots;
+  auto constants = retrieveObjFunc(currentFrame->frameEntity)->chunk.constants.cbegin();
+  auto caches = retrieveObjFunc(currentFrame->frameEntity)->chunk.caches.data();
+  auto callCaches = retrieveObjFunc(currentFrame->frameEntity)->chunk.callCaches.data();
+  Obj* namedOperand = nullptr;  // The name or function constant of "Chunk::isNamed" instructions, "OP_WIDE" reads it for the wide forms.
+  #define READ_BYTE() (*ip++)
+  #define READ_SHORT() (ip += 2, static_cast<uint16_t>(*(ip - 2) << 8 | *(ip - 1)))
+  #define READ_LONG() (ip += 4, static_cast<uint32_t>(*(ip - 4)) << 24 | static_cast<uint32_t>(*(ip - 3) << 16 | *(ip - 2) << 8 | *(ip - 1)))
+  #define READ_CONSTANT() (*(constants + READ_BYTE()))
+  #define READ_CONSTANT_OBJ() (READ_CONSTANT().asObj())
+  #define READ_INLINE_CACHE() (*(caches + READ_SHORT()))
+  #define READ_CALL_CACHE() (*(callCaches + READ_SHORT()))
+  #define SAVE_FRAME() (currentFrame->ip = ip)
+  #define LOAD_FRAME() \
     do { \
-      checkNumberOperands(2); \
-      auto b = std::get<typeRuntimeNumericValue>(pop());  /* The left operand would be at the bottom. */ \
-      auto a = std::get<typeRuntimeNumericValue>(pop()); \
-      push(a op b); \
+      ip = currentFrame->ip; \
+      slots = currentFrame->slots; \
+      auto& chunk = retrieveObjFunc(currentFrame->frameEntity)->chunk; \
+      constants = chunk.constants.cbegin(); \
+      caches = chunk.caches.data(); \
+      callCaches = chunk.callCaches.data(); \
     } while (false)
-  while (true) {
-#ifdef DEBUG_TRACE_EXECUTION
-    printf("          ■ ");
-    for (auto it = stack.cbegin(); it < stackTop; it++) {
-      printf("[ ");
-      printValue(*it);
-      printf(" ] ");
-    }
-    printf("<-\n");
-    auto currentIp = currentFrame->ip;
-    ChunkDebugger::disassembleInstruction(retrieveObjFunc(currentFrame->frameEntity)->chunk, currentIp);
+  // The arithmetic goes through the "number*" functions of "value.h", which have the integer fast paths.
+  #define NUM_BINARY_OP(fn) \
+    do { \
+      const auto& b = peek(0);  /* The left operand would be at the bottom. */ \
+      const auto& a = peek(1); \
+      if (!bothInts(a, b) && (!a.isNumber() || !b.isNumber())) throwRuntimeError("operands must be numbers."); \
+      const VMValue result = fn(a, b); \
+      stackTop--; \
+      *top() = result; \
+    } while (false)
+  /**
+   * Quickening, a generic instruction rewrites itself into a specialized form after observing its operands, -
+   * and a specialized one whose guard fails rewrites itself back and re-dispatches to the generic form.
+   * All forms of an instruction have the same size, so the rewriting never moves the code around.
+   * "size" is the number of bytes the handler has read so far.
+  */
+  #define QUICKEN(size, op) (const_cast<OpCodeType&>(*(ip - (size))) = (op))
+  #define DEOPTIMIZE(size, op) \
+    do { \
+      QUICKEN(size, op); \
+      ip -= (size); \
+      DISPATCH(); \
+    } while (false)
+  // Register forms read both operands in place, "rhs" is either a local slot or a constant.
+  #define READ_REGISTER() (*(slots + READ_BYTE()))
+  #define REG_BINARY_OP(fn, rhs) \
+    do { \
+      auto& dst = READ_REGISTER(); \
+      const auto& a = READ_REGISTER(); \
+      const auto& b = rhs; \
+      if (!bothInts(a, b) && (!a.isNumber() || !b.isNumber())) throwRuntimeError("operands must be numbers."); \
+      dst = fn(a, b); \
+    } while (false)
+  #define LOCAL_CONSTANT_OP(fn) \
+    do { \
+      const auto& a = READ_REGISTER(); \
+      const auto& b = READ_CONSTANT(); \
+      if (!bothInts(a, b) && (!a.isNumber() || !b.isNumber())) throwRuntimeError("operands must be numbers."); \
+      push(fn(a, b)); \
+    } while (false)
+  #define REG_JUMP_UNLESS(fn, rhs) \
+    do { \
+      const auto& a = READ_REGISTER(); \
+      const auto& b = rhs; \
+      const auto offset = READ_SHORT(); \
+      if (!bothInts(a, b) && (!a.isNumber() || !b.isNumber())) throwRuntimeError("operands must be numbers."); \
+      if (!fn(a, b)) ip += offset; \
+    } while (false)
+  // The counter may stop being a number in the loop body, the step is added the same way as "OP_ADD" does.
+  #define FOR_LOOP(fn, limit) \
+    do { \
+      auto& counter = READ_REGISTER(); \
+      const auto& bound = limit; \
+      const auto& step = READ_CONSTANT(); \
+      const auto offset = READ_SHORT(); \
+      counter = addValues(counter, step); \
+      if (!bothInts(counter, bound) && (!counter.isNumber() || !bound.isNumber())) throwRuntimeError("operands must be numbers."); \
+      if (fn(counter, bound)) ip -= offset; \
+    } while (false)
+  // The target keeps its old value until the result is computed, the old value replaces the operand for the postfix forms.
+  #define COMPOUND_ASSIGN(target) \
+    do { \
+      auto& variable = target; \
+      const auto op = READ_BYTE(); \
+      const auto old = variable; \
+      variable = compoundValue(op, old, peek(0)); \
+      *top() = (op & COMPOUND_POSTFIX) ? old : variable; \
+    } while (false)
+  #define TRACE_INSTRUCTION() \
+    do { \
+      if constexpr (traced) traceInstruction(ip); \
+    } while (false)
+#ifdef DEBUG_PROFILE_OPCODES
+  #define PROFILE_INSTRUCTION() profiler.record(retrieveObjFunc(currentFrame->frameEntity)->chunk, ip)
+#else
+  #define PROFILE_INSTRUCTION() do {} while (false)
 #endif
-    const auto instruction = readByte();
-    switch (instruction) {
-      case OpCode::OP_ADD: {
+#ifdef VM_COMPUTED_GOTO
+  static void* dispatchTable[] = {
+    [OpCode::OP_CONSTANT] = &&DO_OP_CONSTANT,
+    [OpCode::OP_RETURN] = &&DO_OP_RETURN,
+    [OpCode::OP_NEGATE] = &&DO_OP_NEGATE,
+    [OpCode::OP_ADD] = &&DO_OP_ADD,
+    [OpCode::OP_SUBTRACT] = &&DO_OP_SUBTRACT,
+    [OpCode::OP_MULTIPLY] = &&DO_OP_MULTIPLY,
+    [OpCode::OP_DIVIDE] = &&DO_OP_DIVIDE,
+    [OpCode::OP_NIL] = &&DO_OP_NIL,
+    [OpCode::OP_TRUE] = &&DO_OP_TRUE,
+    [OpCode::OP_FALSE] = &&DO_OP_FALSE,
+    [OpCode::OP_NOT] = &&DO_OP_NOT,
+    [OpCode::OP_EQUAL] = &&DO_OP_EQUAL,
+    [OpCode::OP_GREATER] = &&DO_OP_GREATER,
+    [OpCode::OP_LESS] = &&DO_OP_LESS,
+    [OpCode::OP_POP] = &&DO_OP_POP,
+    [OpCode::OP_DEFINE_GLOBAL] = &&DO_OP_DEFINE_GLOBAL,
+    [OpCode::OP_GET_GLOBAL] = &&DO_OP_GET_GLOBAL,
+    [OpCode::OP_SET_GLOBAL] = &&DO_OP_SET_GLOBAL,
+    [OpCode::OP_GET_LOCAL] = &&DO_OP_GET_LOCAL,
+    [OpCode::OP_SET_LOCAL] = &&DO_OP_SET_LOCAL,
+    [OpCode::OP_JUMP_IF_FALSE] = &&DO_OP_JUMP_IF_FALSE,
+    [OpCode::OP_JUMP] = &&DO_OP_JUMP,
+    [OpCode::OP_LOOP] = &&DO_OP_LOOP,
+    [OpCode::OP_CALL] = &&DO_OP_CALL,
+    [OpCode::OP_CLOSURE] = &&DO_OP_CLOSURE,
+    [OpCode::OP_GET_UPVALUE] = &&DO_OP_GET_UPVALUE,
+    [OpCode::OP_SET_UPVALUE] = &&DO_OP_SET_UPVALUE,
+    [OpCode::OP_CLOSE_UPVALUE] = &&DO_OP_CLOSE_UPVALUE,
+    [OpCode::OP_CLASS] = &&DO_OP_CLASS,
+    [OpCode::OP_SET_PROPERTY] = &&DO_OP_SET_PROPERTY,
+    [OpCode::OP_GET_PROPERTY] = &&DO_OP_GET_PROPERTY,
+    [OpCode::OP_METHOD] = &&DO_OP_METHOD,
+    [OpCode::OP_INVOKE] = &&DO_OP_INVOKE,
+    [OpCode::OP_INHERIT] = &&DO_OP_INHERIT,
+    [OpCode::OP_GET_SUPER] = &&DO_OP_GET_SUPER,
+    [OpCode::OP_SUPER_INVOKE] = &&DO_OP_SUPER_INVOKE,
+    [OpCode::OP_MOVE] = &&DO_OP_MOVE,
+    [OpCode::OP_LOAD_CONSTANT] = &&DO_OP_LOAD_CONSTANT,
+    [OpCode::OP_ADD_RR] = &&DO_OP_ADD_RR,
+    [OpCode::OP_SUBTRACT_RR] = &&DO_OP_SUBTRACT_RR,
+    [OpCode::OP_MULTIPLY_RR] = &&DO_OP_MULTIPLY_RR,
+    [OpCode::OP_DIVIDE_RR] = &&DO_OP_DIVIDE_RR,
+    [OpCode::OP_ADD_RK] = &&DO_OP_ADD_RK,
+    [OpCode::OP_SUBTRACT_RK] = &&DO_OP_SUBTRACT_RK,
+    [OpCode::OP_MULTIPLY_RK] = &&DO_OP_MULTIPLY_RK,
+    [OpCode::OP_DIVIDE_RK] = &&DO_OP_DIVIDE_RK,
+    [OpCode::OP_JUMP_IF_NOT_LESS_RR] = &&DO_OP_JUMP_IF_NOT_LESS_RR,
+    [OpCode::OP_JUMP_IF_NOT_GREATER_RR] = &&DO_OP_JUMP_IF_NOT_GREATER_RR,
+    [OpCode::OP_JUMP_IF_NOT_LESS_RK] = &&DO_OP_JUMP_IF_NOT_LESS_RK,
+    [OpCode::OP_JUMP_IF_NOT_GREATER_RK] = &&DO_OP_JUMP_IF_NOT_GREATER_RK,
+    [OpCode::OP_ADD_LOCAL_LOCAL] = &&DO_OP_ADD_LOCAL_LOCAL,
+    [OpCode::OP_ADD_LOCAL_CONSTANT] = &&DO_OP_ADD_LOCAL_CONSTANT,
+    [OpCode::OP_SUBTRACT_LOCAL_CONSTANT] = &&DO_OP_SUBTRACT_LOCAL_CONSTANT,
+    [OpCode::OP_LESS_LOCAL_CONSTANT] = &&DO_OP_LESS_LOCAL_CONSTANT,
+    [OpCode::OP_SET_LOCAL_POP] = &&DO_OP_SET_LOCAL_POP,
+    [OpCode::OP_CALL_GLOBAL] = &&DO_OP_CALL_GLOBAL,
+    [OpCode::OP_POP_JUMP_IF_FALSE] = &&DO_OP_POP_JUMP_IF_FALSE,
+    [OpCode::OP_ADD_NUM] = &&DO_OP_ADD_NUM,
+    [OpCode::OP_ADD_STR] = &&DO_OP_ADD_STR,
+    [OpCode::OP_GET_GLOBAL_DEFINED] = &&DO_OP_GET_GLOBAL_DEFINED,
+    [OpCode::OP_TAIL_CALL] = &&DO_OP_TAIL_CALL,
+    [OpCode::OP_FOR_LOOP_LESS_RR] = &&DO_OP_FOR_LOOP_LESS_RR,
+    [OpCode::OP_FOR_LOOP_GREATER_RR] = &&DO_OP_FOR_LOOP_GREATER_RR,
+    [OpCode::OP_FOR_LOOP_LESS_RK] = &&DO_OP_FOR_LOOP_LESS_RK,
+    [OpCode::OP_FOR_LOOP_GREATER_RK] = &&DO_OP_FOR_LOOP_GREATER_RK,
+    [OpCode::OP_COMPOUND_LOCAL] = &&DO_OP_COMPOUND_LOCAL,
+    [OpCode::OP_COMPOUND_UPVALUE] = &&DO_OP_COMPOUND_UPVALUE,
+    [OpCode::OP_COMPOUND_GLOBAL] = &&DO_OP_COMPOUND_GLOBAL,
+    [OpCode::OP_COMPOUND_PROPERTY] = &&DO_OP_COMPOUND_PROPERTY,
+    [OpCode::OP_GET_CAPTURED] = &&DO_OP_GET_CAPTURED,
+    [OpCode::OP_CONSTANT_LONG] = &&DO_OP_CONSTANT_LONG,
+    [OpCode::OP_JUMP_LONG] = &&DO_OP_JUMP_LONG,
+    [OpCode::OP_JUMP_IF_FALSE_LONG] = &&DO_OP_JUMP_IF_FALSE_LONG,
+    [OpCode::OP_LOOP_LONG] = &&DO_OP_LOOP_LONG,
+    [OpCode::OP_WIDE] = &&DO_OP_WIDE,
+    [OpCode::OP_INTRINSIC] = &&DO_OP_INTRINSIC,
+    [OpCode::OP_SWITCH_TABLE] = &&DO_OP_SWITCH_TABLE,
+    [OpCode::OP_SWITCH_HASH] = &&DO_OP_SWITCH_HASH,
+    [OpCode::OP_TAIL_INVOKE] = &&DO_OP_TAIL_INVOKE,
+    [OpCode::OP_TAIL_SUPER_INVOKE] = &&DO_OP_TAIL_SUPER_INVOKE,
+  };
+  #define INTERPRET_LOOP DISPATCH();
+  #define CASE_CODE(name) DO_##name
+  #define DISPATCH() \
+    do { \
+      TRACE_INSTRUCTION(); \
+      PROFILE_INSTRUCTION(); \
+      goto *dispatchTable[READ_BYTE()]; \
+    } while (false)
+#else
+  #define INTERPRET_LOOP \
+    loop: \
+      TRACE_INSTRUCTION(); \
+      PROFILE_INSTRUCTION(); \
+      switch (READ_BYTE())
+  #define CASE_CODE(name) case OpCode::name
+  #define DISPATCH() goto loop
+#endif
+  try {
+    INTERPRET_LOOP {
+      CASE_CODE(OP_ADD): {
         const auto y = pop();
         const auto x = pop();
-        if (isNumericValue(x) && isNumericValue(y)) {
-          push(std::get<typeRuntimeNumericValue>(x) + std::get<typeRuntimeNumericValue>(y));
-          break;
-        } else if ((isObjStringValue(x) || isObjStringValue(y))) {
-          const auto str = stringifyVariantValue(x) + stringifyVariantValue(y);
-          push(internedConstants.add(str));
-          break;
-        }  
-        throwRuntimeError("invalid operand types for \"+\" operator.");
-      }
-      case OpCode::OP_SUBTRACT: NUM_BINARY_OP(-); break;
-      case OpCode::OP_MULTIPLY: NUM_BINARY_OP(*); break;
-      case OpCode::OP_DIVIDE: NUM_BINARY_OP(/); break;
-      case OpCode::OP_NEGATE: {
+        if (x.isNumber() && y.isNumber()) {
+          QUICKEN(1, OpCode::OP_ADD_NUM);
+          push(numberAdd(x, y));
+        } else {
+          if (isObjStringValue(x) && isObjStringValue(y)) QUICKEN(1, OpCode::OP_ADD_STR);
+          push(concatenate(x, y));
+        }
+        DISPATCH();
+      }
+      CASE_CODE(OP_ADD_NUM): {
+        const auto& y = peek(0);
+        const auto& x = peek(1);
+        if (!x.isNumber() || !y.isNumber()) DEOPTIMIZE(1, OpCode::OP_ADD);
+        const VMValue result = numberAdd(x, y);
+        stackTop--;
+        *top() = result;
+        DISPATCH();
+      }
+      CASE_CODE(OP_ADD_STR): {
+        const auto& y = peek(0);
+        const auto& x = peek(1);
+        if (!isObjStringValue(x) || !isObjStringValue(y)) DEOPTIMIZE(1, OpCode::OP_ADD);
+        // No "std::string" local here, leaving the handler by a computed "goto" wouldn't destroy it. -
+        // The operands stay on the stack while allocating, for GC.
+        const auto result = internedConstants.add(x.asObj()->cast<ObjString>()->str + y.asObj()->cast<ObjString>()->str);
+        stackTop--;
+        *top() = result;
+        DISPATCH();
+      }
+      CASE_CODE(OP_SUBTRACT): NUM_BINARY_OP(numberSubtract); DISPATCH();
+      CASE_CODE(OP_MULTIPLY): NUM_BINARY_OP(numberMultiply); DISPATCH();
+      CASE_CODE(OP_DIVIDE): NUM_BINARY_OP(numberDivide); DISPATCH();
+      CASE_CODE(OP_NEGATE): {
         checkNumberOperands(1);
-        *top() = -std::get<typeRuntimeNumericValue>(*top());
-        break;
+        *top() = numberNegate(*top());
+        DISPATCH();
       }
-      case OpCode::OP_RETURN: {
+      CASE_CODE(OP_RETURN): {
+        closeUpvalues(&*slots);  // Before popping the result, closing may allocate.
         const auto result = pop();
-        closeUpvalues(currentFrame->slots);
         frameCount--;
         if (frameCount == 0) {
           pop();  // Dicard the main script function.
           return VMResult::INTERPRET_OK;
         }
-        stackTop = currentFrame->slots;  // Discard all the unused locals.
+        stackTop = slots;  // Discard all the unused locals.
         push(result);
         currentFrame = &frames[frameCount - 1];
-        break;
+        LOAD_FRAME();  // Resume the caller.
+        DISPATCH();
       }
-      case OpCode::OP_CONSTANT: {
-        push(readConstant());
-        break;
+      CASE_CODE(OP_CONSTANT): {
+        push(READ_CONSTANT());
+        DISPATCH();
       }
-      case OpCode::OP_NIL: push(std::monostate {}); break;
-      case OpCode::OP_TRUE: push(true); break;
-      case OpCode::OP_FALSE: push(false); break;
-      case OpCode::OP_NOT: push(isFalsey(pop())); break;
-      case OpCode::OP_EQUAL: {
+      CASE_CODE(OP_NIL): push(std::monostate {}); DISPATCH();
+      CASE_CODE(OP_TRUE): push(true); DISPATCH();
+      CASE_CODE(OP_FALSE): push(false); DISPATCH();
+      CASE_CODE(OP_NOT): push(isFalsey(pop())); DISPATCH();
+      CASE_CODE(OP_EQUAL): {
         const auto x = pop();
         const auto y = pop();
-        push(x == y);
-        break;
-      }
-      case OpCode::OP_GREATER: NUM_BINARY_OP(>); break;
-      case OpCode::OP_LESS: NUM_BINARY_OP(<); break;
-      case OpCode::OP_POP: pop(); break;
-      case OpCode::OP_DEFINE_GLOBAL: {
-        globals[readConstantOfType<Obj*>()] = pop();
-        break;
-      }
-      case OpCode::OP_GET_GLOBAL: {
-        const auto name = readConstantOfType<Obj*>();
-        const auto value = globals.find(name);
-        if (value == globals.end()) {
-          throwRuntimeError("undefined variable '" + name->cast<ObjString>()->str + "'.");
+        push(valuesEqual(x, y));
+        DISPATCH();
+      }
+      CASE_CODE(OP_GREATER): NUM_BINARY_OP(numberGreater); DISPATCH();
+      CASE_CODE(OP_LESS): NUM_BINARY_OP(numberLess); DISPATCH();
+      CASE_CODE(OP_POP): pop(); DISPATCH();
+      CASE_CODE(OP_DEFINE_GLOBAL): {
+        globals.values[READ_SHORT()] = materialize(peek(0));
+        pop();
+        DISPATCH();
+      }
+      CASE_CODE(OP_GET_GLOBAL): {
+        const auto slot = READ_SHORT();
+        const auto value = globals.values[slot];
+        if (value.isUndefined()) {
+          throwRuntimeError("undefined variable '" + globals.names[slot]->cast<ObjString>()->str + "'.");
         }
-        push(value->second);
-        break;
-      }
-      case OpCode::OP_SET_GLOBAL: {
-        const auto name = readConstantOfType<Obj*>();
-         if (!globals.contains(name)) {
-          throwRuntimeError("undefined variable '" + name->cast<ObjString>()->str + "'.");
-         }
-        globals[name] = peek(0);  // Assignment expression doesn’t pop the value off the stack.
-        break;
-      }
-      case OpCode::OP_GET_LOCAL: {
-        push(*(currentFrame->slots + readByte()));  // Take the operand from stack (local slot), and load the value.
-        break;
-      }
-      case OpCode::OP_SET_LOCAL: {
-        *(currentFrame->slots + readByte()) = peek(0);
-        break;
-      }
-      case OpCode::OP_JUMP_IF_FALSE: {
-        auto offset = readShort();
-        if (isFalsey(peek(0))) currentFrame->ip += offset;
-        break;
-      }
-      case OpCode::OP_LOOP: {
-        currentFrame->ip -= readShort();
-        break;
-      }
-      case OpCode::OP_JUMP: {
-        currentFrame->ip += readShort();
-        break;
-      }
-      case OpCode::OP_CALL: {
+        QUICKEN(3, OpCode::OP_GET_GLOBAL_DEFINED);  // A defined global never becomes undefined again.
+        push(value);
+        DISPATCH();
+      }
+      CASE_CODE(OP_GET_GLOBAL_DEFINED): {
+        push(globals.values[READ_SHORT()]);
+        DISPATCH();
+      }
+      CASE_CODE(OP_CALL_GLOBAL): {
+        const auto slot = READ_SHORT();
+        const auto value = globals.values[slot];
+        if (value.isUndefined()) {
+          throwRuntimeError("undefined variable '" + globals.names[slot]->cast<ObjString>()->str + "'.");
+        }
+        push(value);
+        auto& cache = READ_CALL_CACHE();
+        SAVE_FRAME();
+        cachedCall(peek(0), 0, cache);
+        LOAD_FRAME();
+        DISPATCH();
+      }
+      CASE_CODE(OP_SET_GLOBAL): {
+        const auto slot = READ_SHORT();
+        auto& value = globals.values[slot];
+        if (value.isUndefined()) {
+          throwRuntimeError("undefined variable '" + globals.names[slot]->cast<ObjString>()->str + "'.");
+        }
+        value = materialize(peek(0));  // Assignment expression doesn’t pop the value off the stack.
+        DISPATCH();
+      }
+      CASE_CODE(OP_GET_LOCAL): {
+        push(*(slots + READ_BYTE()));  // Take the operand from stack (local slot), and load the value.
+        DISPATCH();
+      }
+      CASE_CODE(OP_SET_LOCAL): {
+        *(slots + READ_BYTE()) = peek(0);
+        DISPATCH();
+      }
+      CASE_CODE(OP_SET_LOCAL_POP): {
+        *(slots + READ_BYTE()) = pop();
+        DISPATCH();
+      }
+      CASE_CODE(OP_ADD_LOCAL_LOCAL): {
+        const auto& a = READ_REGISTER();
+        push(addValues(a, READ_REGISTER()));
+        DISPATCH();
+      }
+      CASE_CODE(OP_ADD_LOCAL_CONSTANT): {
+        const auto& a = READ_REGISTER();
+        push(addValues(a, READ_CONSTANT()));
+        DISPATCH();
+      }
+      CASE_CODE(OP_SUBTRACT_LOCAL_CONSTANT): LOCAL_CONSTANT_OP(numberSubtract); DISPATCH();
+      CASE_CODE(OP_LESS_LOCAL_CONSTANT): LOCAL_CONSTANT_OP(numberLess); DISPATCH();
+      CASE_CODE(OP_JUMP_IF_FALSE): {
+        const auto offset = READ_SHORT();
+        if (isFalsey(peek(0))) ip += offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_POP_JUMP_IF_FALSE): {
+        const auto offset = READ_SHORT();
+        if (isFalsey(pop())) ip += offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_LOOP): {
+        const auto offset = READ_SHORT();
+        ip -= offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_JUMP): {
+        const auto offset = READ_SHORT();
+        ip += offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_CALL): {
         /**
                     frame->slots           StackTop
                           │                    │
@@ -305,112 +736,371 @@ VMResult VM::run(void) {
             └──────┴──────0──────1──────2──────3
                           ┼   A() CallFrame    ┼
         */
-        const auto argCount = readByte();
-        callValue(peek(argCount), argCount);
-        break;
-      }
-      case OpCode::OP_GET_UPVALUE: {
-        const auto slot = readByte();
-        push(*currentFrame->frameEntity->cast<ObjClosure>()->upvalues[slot]->location);
-        break;
-      }
-      case OpCode::OP_SET_UPVALUE: {
-        const auto slot = readByte();
-        *currentFrame->frameEntity->cast<ObjClosure>()->upvalues[slot]->location = peek(0);
-        break;
-      }
-      case OpCode::OP_CLOSURE: {
-        auto closure = mem->makeObj<ObjClosure>(retrieveObjFunc(readConstantOfType<Obj*>()));
+        const auto argCount = READ_BYTE();
+        auto& cache = READ_CALL_CACHE();
+        SAVE_FRAME();
+        cachedCall(peek(argCount), argCount, cache);
+        LOAD_FRAME();  // Switch to the callee (if any).
+        DISPATCH();
+      }
+      CASE_CODE(OP_TAIL_CALL): {
+        const auto argCount = READ_BYTE();
+        auto& cache = READ_CALL_CACHE();
+        SAVE_FRAME();
+        const auto depth = frameCount;
+        cachedCall(peek(argCount), argCount, cache);
+        if (frameCount > depth) {
+          replaceCallerFrame();
+        }  // Otherwise the result is already on the stack, and the following "OP_RETURN" returns it.
+        LOAD_FRAME();
+        DISPATCH();
+      }
+      CASE_CODE(OP_GET_UPVALUE): {
+        const auto slot = READ_BYTE();
+        push(*currentFrame->frameEntity->cast<ObjClosure>()->upvalue(slot)->location);
+        DISPATCH();
+      }
+      CASE_CODE(OP_SET_UPVALUE): {
+        const auto slot = READ_BYTE();
+        *currentFrame->frameEntity->cast<ObjClosure>()->upvalue(slot)->location = materialize(peek(0));  // It may be closed already.
+        DISPATCH();
+      }
+      CASE_CODE(OP_CONSTANT_LONG): {
+        const uint32_t high = READ_BYTE();
+        push(*(constants + (high << 16 | READ_SHORT())));
+        DISPATCH();
+      }
+      CASE_CODE(OP_JUMP_LONG): {
+        const auto offset = READ_LONG();
+        ip += offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_JUMP_IF_FALSE_LONG): {
+        const auto offset = READ_LONG();
+        if (isFalsey(peek(0))) ip += offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_LOOP_LONG): {
+        const auto offset = READ_LONG();
+        ip -= offset;
+        DISPATCH();
+      }
+      CASE_CODE(OP_WIDE): {  // Rare, so the wide forms share a single handler.
+        const auto prefixed = READ_BYTE();
+        const auto index = READ_SHORT();
+        switch (prefixed) {
+          case OpCode::OP_GET_LOCAL: push(*(slots + index)); break;
+          case OpCode::OP_SET_LOCAL: *(slots + index) = peek(0); break;
+          case OpCode::OP_COMPOUND_LOCAL: COMPOUND_ASSIGN(*(slots + index)); break;
+          case OpCode::OP_GET_UPVALUE: push(*currentFrame->frameEntity->cast<ObjClosure>()->upvalue(index)->location); break;
+          case OpCode::OP_SET_UPVALUE: {
+            *currentFrame->frameEntity->cast<ObjClosure>()->upvalue(index)->location = materialize(peek(0));
+            break;
+          }
+          case OpCode::OP_GET_CAPTURED: push(currentFrame->frameEntity->cast<ObjClosure>()->upvalues()[index]); break;
+          case OpCode::OP_COMPOUND_UPVALUE: COMPOUND_ASSIGN(*currentFrame->frameEntity->cast<ObjClosure>()->upvalue(index)->location); break;
+          default: {  // A named instruction, it goes on past the read of its 8-bit constant.
+            namedOperand = (*(constants + index)).asObj();
+            switch (prefixed) {
+              case OpCode::OP_CLOSURE: goto WIDE_OP_CLOSURE;
+              case OpCode::OP_CLASS: goto WIDE_OP_CLASS;
+              case OpCode::OP_GET_PROPERTY: goto WIDE_OP_GET_PROPERTY;
+              case OpCode::OP_SET_PROPERTY: goto WIDE_OP_SET_PROPERTY;
+              case OpCode::OP_COMPOUND_PROPERTY: goto WIDE_OP_COMPOUND_PROPERTY;
+              case OpCode::OP_METHOD: goto WIDE_OP_METHOD;
+              case OpCode::OP_INVOKE: goto WIDE_OP_INVOKE;
+              case OpCode::OP_TAIL_INVOKE: goto WIDE_OP_TAIL_INVOKE;
+              case OpCode::OP_GET_SUPER: goto WIDE_OP_GET_SUPER;
+              case OpCode::OP_SUPER_INVOKE: goto WIDE_OP_SUPER_INVOKE;
+              case OpCode::OP_TAIL_SUPER_INVOKE: goto WIDE_OP_TAIL_SUPER_INVOKE;
+              default: ;
+            }
+          }
+        }
+        DISPATCH();
+      }
+      CASE_CODE(OP_INTRINSIC): {
+        const auto id = READ_BYTE();
+        const auto argCount = INTRINSICS[id].arity;
+        if (peek(argCount).bits != VMValue(intrinsics[id]).bits) [[unlikely]] {  // The global has been reassigned.
+          SAVE_FRAME();
+          callValue(peek(argCount), argCount);
+          LOAD_FRAME();
+          DISPATCH();
+        }
+        const auto result = applyIntrinsic(id, stackTop - argCount);
+        if (result.isUndefined()) throwRuntimeError(intrinsicTypeError(id));
+        stackTop -= argCount;
+        *(stackTop - 1) = result;  // Replace the callee.
+        DISPATCH();
+      }
+      CASE_CODE(OP_SWITCH_TABLE): {
+        const auto& chunk = retrieveObjFunc(currentFrame->frameEntity)->chunk;
+        const auto& table = chunk.switchTables[READ_SHORT()];
+        ip = chunk.code.cbegin() + table.denseTarget(pop());
+        DISPATCH();
+      }
+      CASE_CODE(OP_SWITCH_HASH): {
+        const auto& chunk = retrieveObjFunc(currentFrame->frameEntity)->chunk;
+        const auto& table = chunk.switchTables[READ_SHORT()];
+        ip = chunk.code.cbegin() + table.hashedTarget(pop());
+        DISPATCH();
+      }
+      CASE_CODE(OP_GET_CAPTURED): {
+        push(currentFrame->frameEntity->cast<ObjClosure>()->upvalues()[READ_BYTE()]);
+        DISPATCH();
+      }
+      CASE_CODE(OP_CLOSURE): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_CLOSURE:
+        auto closure = mem->makeObj<ObjClosure>(retrieveObjFunc(namedOperand));
         push(closure);
         for (uint32_t i = 0; i < closure->upvalueCount; i++) {
-          uint8_t isLocal = readByte();
-          uint8_t index = readByte();
-          if (isLocal == 1) {
-            closure->upvalues[i] = captureUpvalue(&*(currentFrame->slots + index));
+          uint8_t kind = READ_BYTE();
+          uint16_t index = (kind & CAPTURE_WIDE) ? READ_SHORT() : READ_BYTE();
+          kind &= ~CAPTURE_WIDE;
+          if (kind == CAPTURE_LOCAL) {
+            closure->upvalues()[i] = captureUpvalue(&*(slots + index));
+          } else if (kind == CAPTURE_LOCAL_VALUE) {
+            closure->upvalues()[i] = materialize(*(slots + index));
           } else {
-            closure->upvalues[i] = currentFrame->frameEntity->cast<ObjClosure>()->upvalues[index];
+            closure->upvalues()[i] = currentFrame->frameEntity->cast<ObjClosure>()->upvalues()[index];  // Either kind, as it is.
           }
         }
-        break;
+        DISPATCH();
       }
-      case OpCode::OP_CLOSE_UPVALUE: {
+      CASE_CODE(OP_CLOSE_UPVALUE): {
         closeUpvalues(&*(stackTop - 1));  // Hoisting the local to heap.
         pop();  // Then, discard it from the stack.
-        break;
+        DISPATCH();
       }
-      case OpCode::OP_CLASS: {
-        const auto name = readConstantOfType<Obj*>();
-        push(mem->makeObj<ObjClass>(name->cast<ObjString>()));
-        break;
+      CASE_CODE(OP_CLASS): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_CLASS:
+        const auto name = namedOperand;
+        push(mem->makeObj<ObjClass>(name->cast<ObjString>(), &methodTable));
+        DISPATCH();
       }
-      case OpCode::OP_GET_PROPERTY: {
-        Obj* obj = nullptr;
-        if (!std::holds_alternative<Obj*>(peek()) || (obj = std::get<Obj*>(peek()))->type != ObjType::OBJ_INSTANCE) {
+      CASE_CODE(OP_GET_PROPERTY): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_GET_PROPERTY:
+        if (!isObjType(peek(), ObjType::OBJ_INSTANCE)) {
           throwRuntimeError("only instances have properties.");
         }
-        auto instance = obj->cast<ObjInstance>();
-        const auto name = readConstantOfType<Obj*>();
-        const auto valIt = instance->fields.find(name);
-        if (valIt != instance->fields.end()) {
-          pop();  // Pop the instance object.
-          push(valIt->second);
+        auto instance = peek().asObj()->cast<ObjInstance>();
+        const auto name = namedOperand;
+        const auto resolved = lookupProperty(READ_INLINE_CACHE(), instance->klass, instance->shape, name);
+        if (resolved.slot != ObjShape::NO_SLOT) {
+          *top() = instance->fields[resolved.slot];  // Replace the instance object.
         } else {
-          bindMethod(instance->klass, name);
+          bindMethod(resolved.method);
         }
-        break;
+        DISPATCH();
       }
-      case OpCode::OP_SET_PROPERTY: {
-        Obj* obj = nullptr;
-        if (!std::holds_alternative<Obj*>(peek(1)) || (obj = std::get<Obj*>(peek(1)))->type != ObjType::OBJ_INSTANCE) {
+      CASE_CODE(OP_SET_PROPERTY): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_SET_PROPERTY:
+        if (!isObjType(peek(1), ObjType::OBJ_INSTANCE)) {
           throwRuntimeError("only instances have properties.");
         }
-        auto instance = obj->cast<ObjInstance>();
-        const auto name = readConstantOfType<Obj*>();
-        instance->fields[name] = peek(0);
+        auto instance = peek(1).asObj()->cast<ObjInstance>();
+        const auto name = namedOperand;
+        setField(instance, name, peek(0));
         const auto value = pop();
         pop();
         push(value);  // Leave the assigned value on the stack.
-        break;
+        DISPATCH();
       }
-      case OpCode::OP_METHOD: {
-        defineMethod(readConstantOfType<Obj*>());
-        break;
+      CASE_CODE(OP_METHOD): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_METHOD:
+        defineMethod(namedOperand);
+        DISPATCH();
       }
-      case OpCode::OP_INVOKE: {
-        const auto methodName = readConstantOfType<Obj*>();
-        const auto argCount = readByte();
-        invoke(methodName, argCount);
+      CASE_CODE(OP_INVOKE): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_INVOKE:
+        const auto methodName = namedOperand;
+        const auto argCount = READ_BYTE();
+        auto& cache = READ_INLINE_CACHE();
+        SAVE_FRAME();
+        invoke(methodName, argCount, cache);
         currentFrame = &frames[frameCount - 1];  // Update frame to the latest called method.
-        break;
+        LOAD_FRAME();
+        DISPATCH();
       }
-      case OpCode::OP_INHERIT: {
-        Obj* superclass = nullptr;
-        if (!std::holds_alternative<Obj*>(peek(1)) || (superclass = std::get<Obj*>(peek(1)))->type != ObjType::OBJ_CLASS) {
+      CASE_CODE(OP_INHERIT): {
+        if (!isObjType(peek(1), ObjType::OBJ_CLASS)) {
           throwRuntimeError("super class must be a class.");
         }
-        auto subclass = peekOfType<Obj*>(0);
-        for (const auto& entity : superclass->cast<ObjClass>()->methods) {  // Copy the inherited methods to subclass.
-          subclass->cast<ObjClass>()->methods[entity.first] = entity.second;
-        }
-        break;
+        const auto superclass = peek(1).asObj();
+        auto subclass = peek(0).asObj();
+        // Share the method row of superclass, it runs before the subclass defines its own ones (which copy the row).
+        subclass->cast<ObjClass>()->inherit(superclass->cast<ObjClass>());
+        subclass->cast<ObjClass>()->version++;
+        pop();  // Pop the subclass, leave the superclass as the "super" local.
+        DISPATCH();
       }
-      case OpCode::OP_GET_SUPER: {
-        const auto methodName = readConstantOfType<Obj*>();
-        const auto superclass = std::get<Obj*>(pop())->cast<ObjClass>();
+      CASE_CODE(OP_GET_SUPER): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_GET_SUPER:
+        const auto methodName = namedOperand;
+        const auto superclass = pop().asObj()->cast<ObjClass>();
         bindMethod(superclass, methodName);  // The instance is on the top of stack.
-        break;
+        DISPATCH();
       }
-      case OpCode::OP_SUPER_INVOKE: {
-        const auto methodName = readConstantOfType<Obj*>();
-        const auto argCount = readByte();
-        const auto superclass = std::get<Obj*>(pop())->cast<ObjClass>();
-        invokeFromClass(superclass, methodName, argCount);
+      CASE_CODE(OP_SUPER_INVOKE): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_SUPER_INVOKE:
+        const auto methodName = namedOperand;
+        const auto argCount = READ_BYTE();
+        auto& cache = READ_INLINE_CACHE();
+        const auto superclass = pop().asObj()->cast<ObjClass>();
+        SAVE_FRAME();
+        call(lookupProperty(cache, superclass, nullptr, methodName).method, argCount);
         currentFrame = &frames[frameCount - 1];  // Update frame to the latest called method.
-        break;
+        LOAD_FRAME();
+        DISPATCH();
+      }
+      CASE_CODE(OP_TAIL_INVOKE): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_TAIL_INVOKE:
+        const auto methodName = namedOperand;
+        const auto argCount = READ_BYTE();
+        auto& cache = READ_INLINE_CACHE();
+        SAVE_FRAME();
+        const auto depth = frameCount;
+        invoke(methodName, argCount, cache);
+        currentFrame = &frames[frameCount - 1];
+        if (frameCount > depth) {
+          replaceCallerFrame();
+        }  // Otherwise a native (held by a field) left the result, the following "OP_RETURN" returns it.
+        LOAD_FRAME();
+        DISPATCH();
+      }
+      CASE_CODE(OP_TAIL_SUPER_INVOKE): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_TAIL_SUPER_INVOKE:
+        const auto methodName = namedOperand;
+        const auto argCount = READ_BYTE();
+        auto& cache = READ_INLINE_CACHE();
+        const auto superclass = pop().asObj()->cast<ObjClass>();
+        SAVE_FRAME();
+        call(lookupProperty(cache, superclass, nullptr, methodName).method, argCount);
+        currentFrame = &frames[frameCount - 1];
+        replaceCallerFrame();  // A superclass method is always a function or closure.
+        LOAD_FRAME();
+        DISPATCH();
+      }
+      CASE_CODE(OP_MOVE): {
+        auto& dst = READ_REGISTER();
+        dst = READ_REGISTER();
+        DISPATCH();
+      }
+      CASE_CODE(OP_LOAD_CONSTANT): {
+        auto& dst = READ_REGISTER();
+        dst = READ_CONSTANT();
+        DISPATCH();
+      }
+      CASE_CODE(OP_ADD_RR): {
+        auto& dst = READ_REGISTER();
+        const auto& a = READ_REGISTER();
+        dst = addValues(a, READ_REGISTER());
+        DISPATCH();
+      }
+      CASE_CODE(OP_SUBTRACT_RR): REG_BINARY_OP(numberSubtract, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_MULTIPLY_RR): REG_BINARY_OP(numberMultiply, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_DIVIDE_RR): REG_BINARY_OP(numberDivide, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_ADD_RK): {
+        auto& dst = READ_REGISTER();
+        const auto& a = READ_REGISTER();
+        dst = addValues(a, READ_CONSTANT());
+        DISPATCH();
+      }
+      CASE_CODE(OP_SUBTRACT_RK): REG_BINARY_OP(numberSubtract, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_MULTIPLY_RK): REG_BINARY_OP(numberMultiply, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_DIVIDE_RK): REG_BINARY_OP(numberDivide, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_JUMP_IF_NOT_LESS_RR): REG_JUMP_UNLESS(numberLess, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_JUMP_IF_NOT_GREATER_RR): REG_JUMP_UNLESS(numberGreater, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_JUMP_IF_NOT_LESS_RK): REG_JUMP_UNLESS(numberLess, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_JUMP_IF_NOT_GREATER_RK): REG_JUMP_UNLESS(numberGreater, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_FOR_LOOP_LESS_RR): FOR_LOOP(numberLess, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_FOR_LOOP_GREATER_RR): FOR_LOOP(numberGreater, READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_FOR_LOOP_LESS_RK): FOR_LOOP(numberLess, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_FOR_LOOP_GREATER_RK): FOR_LOOP(numberGreater, READ_CONSTANT()); DISPATCH();
+      CASE_CODE(OP_COMPOUND_LOCAL): COMPOUND_ASSIGN(READ_REGISTER()); DISPATCH();
+      CASE_CODE(OP_COMPOUND_UPVALUE): {
+        COMPOUND_ASSIGN(*currentFrame->frameEntity->cast<ObjClosure>()->upvalue(READ_BYTE())->location);
+        DISPATCH();
+      }
+      CASE_CODE(OP_COMPOUND_GLOBAL): {
+        const auto slot = READ_SHORT();
+        if (globals.values[slot].isUndefined()) {
+          throwRuntimeError("undefined variable '" + globals.names[slot]->cast<ObjString>()->str + "'.");
+        }
+        COMPOUND_ASSIGN(globals.values[slot]);
+        DISPATCH();
+      }
+      CASE_CODE(OP_COMPOUND_PROPERTY): {
+        namedOperand = READ_CONSTANT_OBJ();
+      WIDE_OP_COMPOUND_PROPERTY:
+        if (!isObjType(peek(1), ObjType::OBJ_INSTANCE)) {
+          throwRuntimeError("only instances have properties.");
+        }
+        auto instance = peek(1).asObj()->cast<ObjInstance>();
+        const auto name = namedOperand;
+        const auto op = READ_BYTE();
+        const auto resolved = lookupProperty(READ_INLINE_CACHE(), instance->klass, instance->shape, name);
+        VMValue old;
+        if (resolved.slot != ObjShape::NO_SLOT) {
+          auto& field = instance->fields[resolved.slot];  // Updated in place, the shape does not change.
+          old = field;
+          field = compoundValue(op, old, peek(0));
+          peek(0) = field;
+        } else {
+          /**
+           * A method is bound and the result is added as a field shadowing it, the same as "a.m = a.m + x". -
+           * The bound method is not rooted, but it is only read before the result gets allocated (a postfix operand never concatenates).
+          */
+          old = mem->makeObj<ObjBoundMethod>(peek(1), resolved.method);
+          peek(0) = compoundValue(op, old, peek(0));  // Keep the result on the stack while "setField" may allocate a shape.
+          setField(instance, name, peek(0));
+        }
+        const auto result = (op & COMPOUND_POSTFIX) ? old : peek(0);
+        stackTop--;
+        *top() = result;  // Replace the instance.
+        DISPATCH();
       }
     }
+  } catch (const VMError& err) {
+    // The error was raised against a stale frame "ip", re-anchor it to the faulting instruction.
+    SAVE_FRAME();
+    throw VMError { currentLine(), err.msg };
   }
+  return VMResult::INTERPRET_RUNTIME_ERROR;  // Unreachable, every opcode handler dispatches or returns.
+  #undef READ_BYTE
+  #undef READ_SHORT
+  #undef READ_LONG
+  #undef READ_CONSTANT
+  #undef READ_CONSTANT_OBJ
+  #undef READ_INLINE_CACHE
+  #undef READ_CALL_CACHE
+  #undef SAVE_FRAME
+  #undef LOAD_FRAME
   #undef NUM_BINARY_OP
+  #undef QUICKEN
+  #undef DEOPTIMIZE
+  #undef READ_REGISTER
+  #undef REG_BINARY_OP
+  #undef REG_JUMP_UNLESS
+  #undef LOCAL_CONSTANT_OP
+  #undef FOR_LOOP
+  #undef COMPOUND_ASSIGN
+  #undef TRACE_INSTRUCTION
+  #undef PROFILE_INSTRUCTION
+  #undef INTERPRET_LOOP
+  #undef CASE_CODE
+  #undef DISPATCH
 }
 
 void VM::stackTrace(void) {
@@ -429,13 +1119,16 @@ void VM::stackTrace(void) {
 
 VMResult VM::interpret(void) {
   if (!isStatusOk) return VMResult::INTERPRET_RUNTIME_ERROR;
+  auto result = VMResult::INTERPRET_RUNTIME_ERROR;
   try {
-    const auto result = run();
+    result = traceExecution ? run<true>() : run<false>();
     freeVM();
-    return result;
   } catch(const VMError& err) {
     Error::vmError(err);
     stackTrace();
-    return VMResult::INTERPRET_RUNTIME_ERROR;
   }
+#ifdef DEBUG_PROFILE_OPCODES
+  profiler.report();
+#endif
+  return result;
 }
@@ -15,6 +15,9 @@
 #include "./error.h"
 #include "./constant.h"
 #include "./object.h"
+#ifdef DEBUG_PROFILE_OPCODES
+#include "./profiler.h"
+#endif
 
 /**
  * Representing a single ongoing function call, -
@@ -26,26 +29,55 @@ struct CallFrame {
   typeVMStack::iterator slots;  // The starting position on the stack of each calling function.
 };
 
-using typeVMFrames = std::array<CallFrame, FRAMES_MAX>;
+using typeVMFrames = std::vector<CallFrame>;
+
+/**
+ * A bound method which lives in a slot of the VM instead of the heap, the stack refers to it by index. -
+ * It turns into an "ObjBoundMethod" once it escapes the stack (see "VM::materialize"), -
+ * the heap object is kept so the escaped copies stay identical.
+*/
+struct StackBoundMethod {
+  VMValue receiver;
+  Obj* method = nullptr;
+  ObjBoundMethod* materialized = nullptr;
+};
 
 struct Memory;
 struct VM {
   Memory* mem;
   size_t frameCount;  // Store the number of ongoing function calls.
-  typeVMStack stack;
-  typeVMFrames frames;
+  typeVMStack stack = typeVMStack(STACK_INITIAL);
+  typeVMFrames frames = typeVMFrames(FRAMES_INITIAL);
   typeVMStack::iterator stackTop;  // Points to the element that just past the last used element.
   InternedConstants internedConstants { mem };
-  typeVMStore<> globals;
+  GlobalSlots globals;
+  DispatchTable methodTable;  // The method rows of all classes.
   CallFrame* currentFrame;
-  ObjUpvalue* openUpvalues = nullptr;
+  /**
+   * The open upvalue of each stack slot (if captured), so capturing a local is a lookup by its offset. -
+   * No slot at or above "openUpvalueTop" has one, returning from a frame that captured nothing checks nothing else.
+  */
+  std::vector<ObjUpvalue*> openUpvalues = std::vector<ObjUpvalue*>(STACK_INITIAL);
+  size_t openUpvalueTop = 0;
   Obj* initString = nullptr;
+  ObjShape* rootShape = nullptr;  // The shape of instances without fields.
+  std::array<Obj*, INTRINSIC_TOTAL> intrinsics = {};  // The native of each intrinsic, "OP_INTRINSIC" only inlines a call to it.
+  std::array<StackBoundMethod, STACK_BOUND_METHODS_MAX> stackBoundMethods;
+  std::vector<uint32_t> freeStackBoundMethods;
+  size_t heapBindCountdown = 0;  // Bound methods to allocate on the heap before trying to reclaim the slots again.
   // For GC.
   std::vector<Obj*> grayStack = {};
   bool isStatusOk = true;
-  explicit VM(std::vector<Token>& tokens, Memory* mem) : mem(mem), frameCount(0), stackTop(stack.begin()) {
+  bool traceExecution = false;  // Print the stack and each instruction before running it (see "VM::run").
+#ifdef DEBUG_PROFILE_OPCODES
+  OpcodeProfiler profiler;
+#endif
+  explicit VM(std::vector<Token>& tokens, Memory* mem, bool registerMode = false) : mem(mem), frameCount(0), stackTop(stack.begin()) {
     // Compiling into byte codes, it returns a new "ObjFunc" containing the compiled top-level code. 
-    const auto function = Compiler { tokens, tokens.cbegin(), mem, &internedConstants }.compile();
+    Compiler compiler { tokens, tokens.cbegin(), mem, &internedConstants };
+    compiler.registerMode = registerMode;
+    compiler.globalSlots = &globals;
+    const auto function = compiler.compile();
     if (!Error::hadError) {
       tokens.clear();
       initVM(function);
@@ -62,67 +94,112 @@ struct VM {
   auto top(void) const {
     return stackTop - 1;
   }
-  void push(const typeRuntimeValue& v) {
+  void push(const VMValue& v) {
     *stackTop = v;
     ++stackTop;
   }
   auto& peek(size_t distance = 0) const {
     return *(stackTop - 1 - distance);
   }
-  template<typename T>
-  T& peekOfType(size_t distance = 0) const {
-    return std::get<T>(peek(distance));
-  }
   auto& pop(void) {
     --stackTop;
     return *stackTop;
   }
   void resetStack(void) {
-    stackTop = stack.data();
+    stackTop = stack.begin();
     frameCount = 0;
   }
-  void throwRuntimeError(const std::string& msg) {
+  [[noreturn]] void throwRuntimeError(const std::string& msg) {
     throw VMError { currentLine(), msg };
   }
   void checkNumberOperands(uint8_t n) {
     auto counter = n + 1;
     while (--counter >= 1) {
-      if (!std::holds_alternative<typeRuntimeNumericValue>(peek(counter - 1)))
+      if (!peek(counter - 1).isNumber())
         throwRuntimeError(n == 1 ? "operand must be a number." : "operands must be numbers.");
     }
   }
-  auto isFalsey(const typeRuntimeValue obj) const {
-    if (std::holds_alternative<std::monostate>(obj)) return true;
-    if (std::holds_alternative<bool>(obj)) return !std::get<bool>(obj);
-    return false;
+  auto isFalsey(const VMValue v) const {
+    return v.isNil() || (v.isBool() && !v.asBool());
   }
-  auto readByte(void) {
-    return *currentFrame->ip++;
+  VMValue addValues(const VMValue& x, const VMValue& y) {
+    if (bothInts(x, y) || (x.isNumber() && y.isNumber())) return numberAdd(x, y);
+    return concatenate(x, y);
   }
-  auto readShort(void) {
-    currentFrame->ip += 2;
-    return static_cast<uint16_t>(*(currentFrame->ip - 2) << 8 | *(currentFrame->ip - 1));
+  /**
+   * Values leaving the stack (into globals, fields, closed upvalues or native functions) go through this.
+  */
+  VMValue materialize(const VMValue& v) {
+    if (!v.isStackBound()) [[likely]] return v;
+    return materializeStackBound(v.asStackBound());
   }
-  auto& readConstant(void) {
-    return retrieveObjFunc(currentFrame->frameEntity)->chunk.constants[readByte()];
+  VMValue materializeStackBound(uint32_t);
+  void reclaimStackBoundMethods(void);
+  bool valuesEqual(const VMValue& x, const VMValue& y) {
+    if (!x.isStackBound() && !y.isStackBound()) [[likely]] return x == y;
+    const auto resolve = [this](const VMValue& v) {  // An escaped copy equals the one still on the stack.
+      if (!v.isStackBound()) return v;
+      const auto materialized = stackBoundMethods[v.asStackBound()].materialized;
+      return materialized == nullptr ? v : VMValue { materialized };
+    };
+    return resolve(x) == resolve(y);
   }
-  template<typename T>
-  T& readConstantOfType(void) {
-    return std::get<T>(readConstant());
+  VMValue compoundValue(OpCodeType op, const VMValue& x, const VMValue& y) {  // "op" is the "operator" operand of "OP_COMPOUND_*".
+    if ((op & ~COMPOUND_POSTFIX) == OpCode::OP_ADD) return addValues(x, y);
+    if (!bothInts(x, y) && (!x.isNumber() || !y.isNumber())) throwRuntimeError("operands must be numbers.");
+    return numberSubtract(x, y);
   }
+  VMValue concatenate(const VMValue&, const VMValue&);
   void call(Obj*, uint8_t);
-  void callValue(typeRuntimeValue&, uint8_t);
-  void defineNative(const char*, ObjNative::typeNativeFn, uint8_t);
-  ObjUpvalue* captureUpvalue(typeRuntimeValue*);
-  void closeUpvalues(typeRuntimeValue*);
-  VMResult run(void);
+  void pushFrame(Obj* callee, const ObjFunc* function, uint8_t argCount) {
+    currentFrame = &frames[frameCount++];
+    currentFrame->frameEntity = callee;
+    currentFrame->ip = function->chunk.code.cbegin();
+    currentFrame->slots = stackTop - argCount - 1;
+  }
+  void callValue(const VMValue&, uint8_t);
+  void resolveCall(VMValue, uint8_t, CallCache&);
+  /**
+   * Call through the cache of a call site. A hit goes straight to the frame setup (the arity was checked when it got cached), -
+   * as long as there are a free frame and enough stack for the callee, the generic path handles growing them.
+  */
+  void cachedCall(const VMValue& callee, uint8_t argCount, CallCache& cache) {
+    if (callee.isObj() &&
+      callee.asObj() == cache.callee &&
+      frameCount < frames.size() &&
+      static_cast<size_t>(stack.end() - stackTop) + argCount + 1 >= cache.function->maxStackHeight) {
+      pushFrame(cache.callee, cache.function, argCount);
+      return;
+    }
+    resolveCall(callee, argCount, cache);  // Miss.
+  }
+  void replaceCallerFrame(void);
+  void reserveStack(size_t);
+  Obj* defineNative(std::string_view, ObjNative::typeNativeFn, uint8_t);
+  ObjUpvalue* captureUpvalue(VMValue*);
+  void closeUpvalues(VMValue*);
+  template <bool traced> VMResult run(void);
+  void traceInstruction(typeVMCodeArray::const_iterator);
   void stackTrace(void);
   void freeVM(void);
   VMResult interpret(void);
   void defineMethod(Obj*);
+  Obj* findMethod(ObjClass*, Obj*);
+  void bindMethod(Obj*);
   void bindMethod(ObjClass*, Obj*);
-  void invokeFromClass(ObjClass*, Obj*, uint8_t);
-  void invoke(Obj*, uint8_t);
+  void invoke(Obj*, uint8_t, InlineCache&);
+  InlineCacheEntry resolveProperty(InlineCache&, ObjClass*, ObjShape*, Obj*);
+  InlineCacheEntry lookupProperty(InlineCache& cache, ObjClass* klass, ObjShape* shape, Obj* name) {
+    if (!cache.megamorphic) {
+      for (uint8_t i = 0; i < cache.count; i++) {
+        const auto& entry = cache.entries[i];
+        if (entry.klass == klass && entry.shape == shape && entry.version == klass->version) return entry;
+      }
+    }
+    return resolveProperty(cache, klass, shape, name);  // Miss.
+  }
+  ObjShape* transitShape(ObjShape*, Obj*);
+  void setField(ObjInstance*, Obj*, const VMValue&);
 };
 
 #endif
@@ -24,8 +24,20 @@
 namespace fs = std::filesystem;
 
 static bool useInterpreterMode = true;
+static bool useRegisterMode = false;
+// Debug builds trace and log by default, the flags turn them on for any build (VM only).
+#ifdef DEBUG_TRACE_EXECUTION
+static bool traceExecution = true;
+#else
+static bool traceExecution = false;
+#endif
+#ifdef DEBUG_LOG_GC
+static bool logGC = true;
+#else
+static bool logGC = false;
+#endif
 static void reportIllegalUsage(void) {
-  std::cerr << "Usage: cpplax [-i|-c] [file]" << std::endl;
+  std::cerr << "Usage: cpplax [-i|-c|-r] [-t] [-g] [file]" << std::endl;
   std::exit(EX_USAGE);
 }
 struct Lax {
@@ -53,7 +65,9 @@ struct Lax {
       std::cout << "- Compiler Mode -\n\n";
 #endif
       Memory memory {};
-      VM vm { tokens, &memory };
+      memory.logGC = logGC;
+      VM vm { tokens, &memory, useRegisterMode };
+      vm.traceExecution = traceExecution;
       vm.interpret();
     }
   }
@@ -88,7 +102,7 @@ struct Lax {
 };
 
 int main(int argc, const char* argv[]) {
-  if (argc > 3) {
+  if (argc > 5) {
     reportIllegalUsage();
   } 
   std::vector<std::string_view> args(argv + 1, argv + argc);
@@ -105,6 +119,22 @@ int main(int argc, const char* argv[]) {
     useInterpreterMode = false;  // Compiler mode goes first.
     args.erase(cflag);
   }
+  auto rflag = std::find(args.begin(), args.end(), "-r");
+  if (rflag != args.end()) {
+    useInterpreterMode = false;  // Register mode runs on the VM as well.
+    useRegisterMode = true;
+    args.erase(rflag);
+  }
+  auto tflag = std::find(args.begin(), args.end(), "-t");
+  if (tflag != args.end()) {
+    traceExecution = true;
+    args.erase(tflag);
+  }
+  auto gflag = std::find(args.begin(), args.end(), "-g");
+  if (gflag != args.end()) {
+    logGC = true;
+    args.erase(gflag);
+  }
   if (args.size() > 1) {
     reportIllegalUsage();
   } else if (args.size() == 1) {